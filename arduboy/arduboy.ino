@@ -13,11 +13,12 @@ ArduMem memory;
 
 ArduboyRender render(boy);
 SerialTracer tracer(false);
-Chip8 emu(render, memory, tracer);
+Chip8<ArduboyRender, ArduMem, SerialTracer> emu(render, memory, tracer);
 
 void setup() {
     boy.boot();
     boy.initRandomSeed();
+    emu.SetSeed(random(0x7FFFFFFF));
     Serial.begin(115200);
     boy.setFrameRate(60);
 }
@@ -68,8 +69,13 @@ void runEmu() {
         program = NULL;
     }
 
-    cycles++;
-    ErrorType error = emu.Step();
+    RunResult result = emu.RunCycles(cycles_per_tick - cycles);
+    cycles += result.Cycles;
+    ErrorType error = result.Error;
+
+    // If nothing ran, the program is waiting for a key or the display, and
+    // won't continue until the next tick.
+    if(result.Cycles == 0) cycles = cycles_per_tick;
     
     if(error != NO_ERROR) {
         boy.setCursor(0,0);
@@ -196,9 +202,8 @@ void loadCurrentItem() {
     memory.load(pgm.code, pgm.size);
 
 
-    emu.SetConfig({
-        .ShiftQuirk = pgm.shiftquirk,
-    });
+    emu.SetConfig(pgm.config);
+    emu.SetAot(pgm.aot);
     // Wait for button release before starting emulator, to avoid 
     // the loader button press from registering in the game.
     while(boy.pressed(A_BUTTON));
@@ -18,7 +18,7 @@
 // While it's possible to construct a program that would run on the original machine, 
 // but results in an OOM here, this implementation is likely to provide enough
 // RAM workspace for most real-world Chip8 games.
-class ArduMem : public SlabMemory {
+class ArduMem final : public SlabMemory {
 
     // The bytes for the program, which reside in PROGMEM
     const uint8_t *mProgram;
@@ -141,11 +141,6 @@ void ArduboyRender::clear() {
     mBoy.clear();
 }
 
-// Random implementation.
-uint8_t ArduboyRender::random() {
-    return ::random(0xFF);
-}
-
 // Set the keymapping that will be used by the buttons method.
 void ArduboyRender::setKeyMap(uint8_t ud, uint8_t lr, uint8_t ab) {
     mKeymapUD = ud;
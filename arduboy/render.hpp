@@ -4,7 +4,7 @@
 #include "src/chip8/render.hpp"
 
 
-class ArduboyRender : public Render {
+class ArduboyRender final : public Render {
 
 private:
     Arduboy2 &mBoy;
@@ -32,6 +32,5 @@ public:
     virtual void beep(uint8_t dur);
     virtual void render();
     virtual void clear();
-    virtual uint8_t random();
     virtual uint16_t buttons();
 };
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "render.hpp"
+#include "../src/chip8/chip8.hpp"
+#include "../src/chip8/simplemem.hpp"
+#include "../src/host/movie.hpp"
+#include "../src/host/statehash.hpp"
+#define PROGMEM
+#include "program.h"
+#include "programs.h"
+
+// Enough decode cache entries to cover the whole 12-bit address space.
+#define DECODE_CACHE_SIZE 0x1000
+
+static void usage() {
+    printf("usage: headless MOVIE [--hashes FILE] [--check FILE]\n");
+    printf("  Replays MOVIE (recorded with `sdl --record`) as fast as possible.\n");
+    printf("  --hashes FILE  write the state hash after each frame to FILE\n");
+    printf("  --check FILE   compare the state hash after each frame with FILE\n");
+}
+
+static const Program* findProgram(const MovieHeader &header) {
+    for(int i = 0; i < PROGRAM_COUNT; i++) {
+        const Program &pgm = programs[i];
+        if(strcmp(pgm.name, header.Program) == 0 && hashProgram(pgm.code, pgm.size) == header.ProgramHash) {
+            return &pgm;
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+    const char *moviePath = NULL;
+    const char *hashesPath = NULL;
+    const char *checkPath = NULL;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--hashes") == 0 && i + 1 < argc) hashesPath = argv[++i];
+        else if(strcmp(argv[i], "--check") == 0 && i + 1 < argc) checkPath = argv[++i];
+        else if(!moviePath && argv[i][0] != '-') moviePath = argv[i];
+        else {
+            usage();
+            return 2;
+        }
+    }
+    if(!moviePath) {
+        usage();
+        return 2;
+    }
+
+    MovieReader movie;
+    if(!movie.open(moviePath)) {
+        printf("Can't read movie %s\n", moviePath);
+        return 2;
+    }
+    const MovieHeader &header = movie.header();
+    const Program *pgm = findProgram(header);
+    if(!pgm) {
+        printf("No program named %s with the recorded code\n", header.Program);
+        return 2;
+    }
+    if(quirkMask(pgm->config) != header.Quirks) {
+        printf("%s was recorded with quirks %02X, but now has %02X\n", header.Program, header.Quirks, quirkMask(pgm->config));
+        return 2;
+    }
+
+    FILE *hashes = NULL;
+    if(hashesPath && !(hashes = fopen(hashesPath, "w"))) {
+        printf("Can't write %s\n", hashesPath);
+        return 2;
+    }
+    FILE *check = NULL;
+    if(checkPath && !(check = fopen(checkPath, "r"))) {
+        printf("Can't read %s\n", checkPath);
+        return 2;
+    }
+
+    HeadlessRender render;
+    SimpleMemory memory;
+    Framebuffer framebuffer;
+    NullTracer tracer;
+    DecodedOp decodedOps[DECODE_CACHE_SIZE];
+    DecodeCache decodeCache(decodedOps, DECODE_CACHE_SIZE);
+    Chip8<HeadlessRender, SimpleMemory, NullTracer> emu(render, memory, tracer);
+    emu.SetFramebuffer(&framebuffer);
+    emu.SetDecodeCache(&decodeCache);
+
+    // The same steps as Chip8Runner::loadEmu.
+    memory.load(pgm->code, pgm->size);
+    emu.SetAot(pgm->aot);
+    emu.SetConfig(pgm->config);
+    emu.SetSeed(header.Seed);
+    emu.Reset();
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t frame = 0;
+    uint32_t hash = 0;
+    uint16_t buttons;
+    int result = 0;
+    while(movie.next(buttons)) {
+        render.setButtons(buttons);
+        emu.RunFrame(header.CyclesPerFrame);
+        hash = hashState(emu.State(), framebuffer, memory);
+        if(hashes) fprintf(hashes, "%08x\n", hash);
+        if(check) {
+            unsigned int expected;
+            if(fscanf(check, "%x", &expected) != 1) {
+                printf("%s ends at frame %u\n", checkPath, frame);
+                result = 1;
+                break;
+            }
+            if(expected != hash) {
+                printf("Frame %u: state hash is %08x, expected %08x\n", frame, hash, expected);
+                result = 1;
+                break;
+            }
+        }
+        frame++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if(frame < header.Frames && result == 0) {
+        printf("Movie ends at frame %u of %u\n", frame, header.Frames);
+        result = 1;
+    }
+    printf("%s: %u frames in %.3fs (%.0fx real time), final hash %08x\n",
+        header.Program, frame, seconds, seconds > 0 ? frame / 60.0 / seconds : 0, hash);
+
+    if(hashes) fclose(hashes);
+    if(check) fclose(check);
+    return result;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "../src/chip8/render.hpp"
+
+// A Render with no screen or sound. The emulator draws into its framebuffer,
+// and the buttons are whatever were last set.
+class HeadlessRender final : public Render {
+    uint16_t mButtons = 0;
+
+    public:
+    void setButtons(uint16_t buttons) { mButtons = buttons; }
+
+    virtual void render() {}
+    virtual void beep(uint8_t dur) {}
+    virtual uint16_t buttons() { return mButtons; }
+};
@@ -6,12 +6,17 @@
 #include "src/arduino/tracer.hpp"
 #include "gamepad.hpp"
 
+// Instructions run each time through the loop, between checks for input and
+// the 60Hz tick.
+#define CYCLES_PER_LOOP 8
+
 M5Gamepad gamepad;
 
 M5Render render(gamepad);
 SimpleMemory memory;
+Framebuffer framebuffer;
 SerialTracer tracer;
-Chip8 emu(render, memory, tracer);
+Chip8<M5Render, SimpleMemory, SerialTracer> emu(render, memory, tracer);
 
 uint32_t next_step = 0;
 uint32_t next_tick = 0;
@@ -30,6 +35,9 @@ void setup() {
     Serial.begin(115200);
     Wire.begin();
 
+    emu.SetFramebuffer(&framebuffer);
+    emu.SetSeed(random(0x7FFFFFFF));
+
 
     ledcWriteTone(TONE_PIN_CHANNEL, 0);
     ledcDetachPin(SPEAKER_PIN);
@@ -55,9 +63,8 @@ void loadCurrentItem() {
     const Program &pgm = programs[pidx];
     render.setKeyMap(pgm.keymap[0], pgm.keymap[1], pgm.keymap[2]);
     memory.load(pgm.code, pgm.size);
-    emu.SetConfig({
-        .ShiftQuirk = pgm.shiftquirk 
-    });
+    emu.SetConfig(pgm.config);
+    emu.SetAot(pgm.aot);
     emu.Reset();
     M5.Lcd.fillScreen(BLACK); 
     render.clear();
@@ -105,9 +112,9 @@ void runEmu() {
     }
 
     uint32_t now = micros();
-    ErrorType error = emu.Step();
-    if(error != NO_ERROR) {
-        handleError(error);
+    RunResult result = emu.RunCycles(CYCLES_PER_LOOP);
+    if(result.Error != NO_ERROR) {
+        handleError(result.Error);
     }
         
     if (now >= next_tick) {
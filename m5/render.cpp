@@ -4,50 +4,50 @@
 
 M5Render::M5Render(M5Gamepad &gamepad) : mGamepad(gamepad) {
     mPixelData = (uint16_t*)mSprite.createSprite(256, 128);
+    clear();
 }
 
 M5Render::~M5Render() {
     mSprite.deleteSprite();
 }
 
-bool M5Render::drawPixel(uint8_t x, uint8_t y, bool drawVal) {
-    uint8_t topy = y * mPixelHeight;
-    uint8_t leftx = x * mPixelWidth;
-    uint16_t offset = (topy * mWidth) + (leftx);
-    uint16_t oldPixel = mSprite.readPixel(leftx, topy);
-    bool wasOn = oldPixel == 0xFFFF;
-    bool on = wasOn ^ drawVal;
-    mSprite.fillRect(leftx, topy, mPixelWidth, mPixelHeight, on ? WHITE : 0);
-    return wasOn & !on;
-}
-
 void M5Render::render() {
     M5.update();
     mSprite.pushSprite(32, 32);
 }
 
+void M5Render::present(const Framebuffer &framebuffer) {
+    for(uint8_t y = 0; y < framebuffer.height(); y++) {
+        const uint8_t *row = framebuffer.row(y);
+        for(uint8_t col = 0; col < framebuffer.width() / 8; col++) {
+            uint8_t changed = row[col] ^ mShown[y][col];
+            if(!changed) continue;
+            for(uint8_t bit = 0; bit < 8; bit++) {
+                uint8_t mask = 0x80 >> bit;
+                if(!(changed & mask)) continue;
+                uint8_t x = col * 8 + bit;
+                mSprite.fillRect(x * mPixelWidth, y * mPixelHeight, mPixelWidth, mPixelHeight,
+                        row[col] & mask ? WHITE : 0);
+            }
+            mShown[y][col] = row[col];
+        }
+    }
+    render();
+}
+
 void M5Render::setMode(RenderMode mode) {
     Render::setMode(mode);
     mPixelWidth = mode == SCHIP8 ? 2 : 4;
     mPixelHeight = mode == CHIP8 ? 4 : 2;
     mWidth = mode == SCHIP8  ? 128 : 64;
     mHeight = mode == CHIP8 ? 32 : 64;
+    // The pixel size changed, so everything has to be redrawn.
+    clear();
 }
 
 void M5Render::clear() {
     mSprite.fillSprite(BLACK);
-}
-
-void M5Render::scrollDown(uint8_t amt) {
-    mSprite.scroll(0, amt * mPixelHeight);
-}
-
-void M5Render::scrollLeft() {
-    mSprite.scroll(-4 * mPixelWidth, 0);
-}
-
-void M5Render::scrollRight() {
-    mSprite.scroll(4 * mPixelWidth, 0);
+    memset(mShown, 0, sizeof(mShown));
 }
 
 void M5Render::beep(uint8_t dur) {
@@ -58,10 +58,6 @@ void M5Render::beep(uint8_t dur) {
     }
 }
 
-uint8_t M5Render::random() {
-    return ::random(0xFF);
-}
-
 // Set the keymapping that will be used by the buttons method.
 void M5Render::setKeyMap(uint8_t ud, uint8_t lr, uint8_t ab) {
     mKeymapUD = ud;
@@ -1,7 +1,8 @@
 #include "src/chip8/render.hpp"
+#include "src/chip8/framebuffer.hpp"
 #include "gamepad.hpp"
 
-class M5Render : public Render {
+class M5Render final : public Render {
     uint16_t* mPixelData;
 
     TFT_eSprite mSprite = TFT_eSprite(&M5.Lcd);
@@ -17,6 +18,10 @@ class M5Render : public Render {
     uint8_t mWidth = 64;
     uint8_t mHeight = 32;
 
+    // The framebuffer contents that are currently in the sprite, so present
+    // only has to redraw pixels that changed.
+    uint8_t mShown[FRAMEBUFFER_HEIGHT][FRAMEBUFFER_ROW_BYTES];
+
     public:
     
     M5Render(M5Gamepad &gamepad);
@@ -24,28 +29,16 @@ class M5Render : public Render {
 
     void setKeyMap(uint8_t ud, uint8_t lr, uint8_t ab);
 
-    // if it should trigger a collision, return true.
-    virtual bool drawPixel(uint8_t x, uint8_t y, bool drawVal);
-
     // draw the screen
     virtual void render();
 
+    // update the screen from the emulator's framebuffer, and draw it
+    virtual void present(const Framebuffer &framebuffer);
+
     // clear the screen
     virtual void clear();
 
     virtual void setMode(RenderMode mode);
-    
-
-    // SUPER CHIP-8
-    
-    // scroll the display down the specified number of lines
-    virtual void scrollDown(uint8_t amt);
-    
-    // scroll the display left 4 columns
-    virtual void scrollLeft();
-    
-    // scroll the display right 4 columns
-    virtual void scrollRight();
 
 
     // Non-drawing rendering
@@ -53,9 +46,6 @@ class M5Render : public Render {
     // implementations should make a noise for dur/60 seconds.
     virtual void beep(uint8_t dur);
 
-    // implementations should return a uniform random number from 0 - 0xFF
-    virtual uint8_t random();
-
     // return the button state. Should return a bitmask for the buttons that have 
     // been pressed, in little-endian order for 0-F.
     virtual uint16_t buttons();
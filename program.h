@@ -1,4 +1,7 @@
 #pragma once
+#include "src/chip8/aot.hpp"
+#include "src/chip8/config.hpp"
+
 struct Program {
     char *name;
     uint8_t *code;
@@ -6,5 +9,8 @@ struct Program {
     bool super;
     uint8_t *info;
     uint8_t keymap[3];
-    bool shiftquirk;
+    // Quirks to run the program with.
+    Config config;
+    // Ahead-of-time compiled code, or NULL.
+    AotFn aot;
 };
@@ -2,14 +2,32 @@
 #include "render.hpp"
 #include <chrono>
 #include <thread>
+#include <ctime>
+#include <string.h>
 
-#define EMU_STEP_DELAY 1000
+// About one instruction per millisecond, run in a batch each tick.
+#define EMU_STEPS_PER_TICK 16
+#define EMU_TICK_DELAY 16
 
-Chip8Runner::Chip8Runner(SDL_Renderer *renderer, std::vector<RunnerProgram> programs) :
+Chip8Runner::Chip8Runner(SDL_Renderer *renderer, std::vector<RunnerProgram> programs, bool recompile, const char *record, uint8_t runAhead, const NetOptions *net) :
     mPrograms(programs),
     mSDL_Renderer(renderer), 
     mRender(renderer),
-    mEmu(mRender, mMemory, mTracer) { }
+    mRecompiler(mMemory),
+    mRecompile(recompile && !record),
+    mEmu(mRender, mRecompile ? (Memory&)mRecompiler : (Memory&)mMemory, mTracer),
+    mDecodeCache(mDecodedOps, DECODE_CACHE_SIZE),
+    mRewindArena(REWIND_ARENA_SIZE),
+    mRewindEntries(REWIND_FRAMES),
+    mRewind(mRewindArena.data(), REWIND_ARENA_SIZE, mRewindEntries.data(), REWIND_FRAMES),
+    mRecordPath(net ? NULL : record),
+    mRunAhead(net ? 0 : runAhead),
+    mNetPlay(net != NULL),
+    mNetStates(net ? NET_MAX_ROLLBACK + 1 : 0) {
+    mEmu.SetDecodeCache(&mDecodeCache);
+    mEmu.SetFramebuffer(&mFramebuffer);
+    if(net) mNetOptions = *net;
+}
 
 Chip8Runner::~Chip8Runner() {
 }
@@ -18,9 +36,37 @@ void Chip8Runner::loadEmu() {
     RunnerProgram& pgm = mPrograms[mProgramIndex];
     printf("Running %s\n", pgm.name);
     mMemory.load(pgm.code, pgm.size);
-    mRender.clear();
-    mEmu.SetConfig((Config){.ShiftQuirk=pgm.shiftquirk});
+    mRecompiler.configure(pgm.config);
+    mEmu.SetAot(pgm.aot);
+    mEmu.SetConfig(pgm.config);
+    // Both players must use the same seed to stay in step.
+    uint32_t seed = mNetPlay ? mNet.seed() : time(NULL);
+    mEmu.SetSeed(seed);
     mEmu.Reset();
+    mRewind.reset();
+    startRecording(pgm, seed);
+}
+
+// Only the first program is recorded: switching programs ends the movie.
+void Chip8Runner::startRecording(const RunnerProgram &pgm, uint32_t seed) {
+    if(mMovie.isOpen()) {
+        if(!mMovie.close()) printf("Error writing recording\n");
+        printf("Recording stopped\n");
+        return;
+    }
+    if(!mRecordPath) return;
+    MovieHeader header = {};
+    strncpy(header.Program, pgm.name, MOVIE_NAME_SIZE - 1);
+    header.ProgramHash = hashProgram(pgm.code, pgm.size);
+    header.Quirks = quirkMask(pgm.config);
+    header.CyclesPerFrame = EMU_STEPS_PER_TICK;
+    header.Seed = seed;
+    if(mMovie.open(mRecordPath, header)) {
+        printf("Recording to %s\n", mRecordPath);
+    } else {
+        printf("Can't record to %s\n", mRecordPath);
+    }
+    mRecordPath = NULL;
 }
 
 
@@ -54,8 +100,10 @@ void Chip8Runner::handleKeyEvent(SDL_Scancode code, bool pressed) {
         case SDL_SCANCODE_X: return mRender.setKeyState(0, pressed);
         case SDL_SCANCODE_C: return mRender.setKeyState(0xB, pressed);
         case SDL_SCANCODE_V: return mRender.setKeyState(0xF, pressed);
-        case SDL_SCANCODE_LEFT: if(pressed) return prevProgram(); else return;
-        case SDL_SCANCODE_RIGHT: if(pressed) return nextProgram(); else return;
+        case SDL_SCANCODE_LEFT: if(pressed && !mNetPlay) return prevProgram(); else return;
+        case SDL_SCANCODE_RIGHT: if(pressed && !mNetPlay) return nextProgram(); else return;
+        // Rewinding would rewrite the history being recorded, or shared.
+        case SDL_SCANCODE_BACKSPACE: mRewinding = pressed && !mMovie.isOpen() && !mNetPlay; return;
         default: return;
     }
 }
@@ -67,6 +115,8 @@ bool Chip8Runner::tick() {
             case SDL_WINDOWEVENT:
                 switch (event.window.event) {
                     case SDL_WINDOWEVENT_CLOSE: return false; 
+                    case SDL_WINDOWEVENT_EXPOSED:
+                    case SDL_WINDOWEVENT_SIZE_CHANGED: mRender.redraw(); break;
                 }
                 break;
             case SDL_KEYDOWN:  
@@ -78,27 +128,159 @@ bool Chip8Runner::tick() {
             case SDL_QUIT: return false;
         }
     }
-    mEmu.Tick();
+    if(mNetPlay) {
+        return netFrame();
+    } else if(mRewinding) {
+        rewindFrame();
+    } else {
+        if(mRunAhead) mRender.setPresenting(false);
+        mEmu.Tick();
+        if(mMovie.isOpen()) mMovie.frame(mEmu.State().Buttons);
+        saveFrame();
+        if(mRunAhead) runAhead();
+    }
     return true;
 }
 
+// Games usually see a keypress a frame or more after it happens, since they
+// only poll the keys once the tick has latched them. To hide that delay, show
+// the frame mRunAhead frames from now instead, as it would be if the keys
+// stay as they are, and then go back to the real state.
+void Chip8Runner::runAhead() {
+    mEmu.Snapshot(mAhead);
+    for(uint8_t i = 1; i <= mRunAhead; i++) {
+        runSteps(EMU_STEPS_PER_TICK);
+        if(i == mRunAhead) {
+            // The frames in between weren't presented, so draw everything.
+            mFramebuffer.touch();
+            mRender.setPresenting(true);
+        }
+        mEmu.Tick();
+    }
+    mEmu.Restore(mAhead);
+}
+
+// Run a frame of netplay. Frames are run without waiting for the peer's
+// inputs, guessing they're the same as last time. When the guess turns out to
+// be wrong, go back to the first frame it was wrong for, and run everything
+// since then again with the right inputs, without showing it. The peer does
+// the same, so both end up in the same state. Returns false if the session
+// can't go on.
+bool Chip8Runner::netFrame() {
+    mNet.poll();
+    if(!mNetStarted) {
+        if(mNet.wrongProgram()) {
+            printf("The other player is running a different program\n");
+            return false;
+        }
+        if(!mNet.connected()) {
+            mNet.send();
+            return true;
+        }
+        if(mNet.keys() & mNet.peerKeys()) {
+            printf("Both players own keys %04X\n", mNet.keys() & mNet.peerKeys());
+        }
+        loadEmu();
+        mNetStarted = true;
+    }
+
+    uint32_t frame = mNet.localFrames();
+    uint32_t from;
+    bool rolledBack = mNet.mispredicted(from);
+    if(rolledBack) {
+        mEmu.Restore(mNetStates[from % mNetStates.size()]);
+        mRender.setPresenting(false);
+        for(uint32_t f = from; f < frame; f++) netStep(f);
+        mRender.setPresenting(true);
+        mFramebuffer.touch();
+    }
+
+    // Running too far past the peer's inputs could need more rolling back
+    // than there are snapshots for, so wait for them instead.
+    if(mNet.canAdvance()) {
+        mNet.addLocalInput(mRender.keys());
+        netStep(frame);
+    } else if(rolledBack) {
+        mRender.present(mFramebuffer);
+        mFramebuffer.clean();
+    }
+    mNet.send();
+    return true;
+}
+
+void Chip8Runner::netStep(uint32_t frame) {
+    mEmu.Snapshot(mNetStates[frame % mNetStates.size()]);
+    runSteps(EMU_STEPS_PER_TICK);
+    mRender.setButtons(mNet.input(frame));
+    mEmu.Tick();
+}
+
+void Chip8Runner::saveFrame() {
+    if(mEmu.Snapshot(mSave)) mRewind.push(mSave);
+}
+
+// Step back a frame, and show it. Once the history runs out, the oldest frame
+// stays on the screen.
+void Chip8Runner::rewindFrame() {
+    const SaveState *save = mRewind.pop();
+    if(save) mEmu.Restore(*save);
+    mRender.present(mFramebuffer);
+    mFramebuffer.clean();
+}
+
 void Chip8Runner::run() {
-    loadEmu();
+    if(!mNetPlay) {
+        loadEmu();
+    } else {
+        // The program is loaded once the peer is found.
+        const RunnerProgram &pgm = mPrograms[mProgramIndex];
+        const NetOptions &net = mNetOptions;
+        if(!mNet.open(net.LocalPort, net.PeerHost, net.PeerPort, net.Keys, hashProgram(pgm.code, pgm.size))) {
+            printf("Can't start netplay on port %d with %s:%d\n", net.LocalPort, net.PeerHost, net.PeerPort);
+            return;
+        }
+        printf("Waiting for %s:%d to play %s\n", net.PeerHost, net.PeerPort, pgm.name);
+    }
     pollEvents();
 }
 
+void Chip8Runner::runSteps(uint16_t count) {
+    if(mRecompile) {
+        uint32_t executed = 0;
+        mRecompiler.Run(mEmu, count, executed);
+        return;
+    }
+    mEmu.RunCycles(count);
+}
+
+// The emulator can't make progress until there's input if it has halted, or is
+// waiting for a key with no delay timer running down.
+bool Chip8Runner::waitingForInput() {
+    // Netplay has to keep talking to the peer.
+    if(mRewinding || mNetPlay) return false;
+    const EmuState &state = mEmu.State();
+    return !state.Running || (state.AwaitingKey && state.DelayTimer == 0);
+}
+
 void Chip8Runner::pollEvents() {
-    uint32_t lastEmu = SDL_GetTicks();
     uint32_t lastRender = SDL_GetTicks();
     while(1) {
+        // Netplay runs its frames from the tick, since they may need to be
+        // run again.
+        if(!mRewinding && !mNetPlay) runSteps(EMU_STEPS_PER_TICK);
         uint32_t ticks = SDL_GetTicks();
-        mEmu.Step();
-        std::this_thread::sleep_for (std::chrono::microseconds(EMU_STEP_DELAY));
-        if (ticks-lastRender > 16) {
-            lastRender = ticks;
-            if(!tick()) {
-                return;
-            }
+        if (ticks-lastRender < EMU_TICK_DELAY) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(EMU_TICK_DELAY - (ticks-lastRender)));
+        }
+        lastRender = SDL_GetTicks();
+        if(!tick()) {
+            return;
+        }
+        // Rather than ticking to no effect, sleep until something happens.
+        // The event is left in the queue for the next tick to handle.
+        if(waitingForInput()) {
+            SDL_WaitEvent(NULL);
+            lastRender = SDL_GetTicks();
         }
     }
 }
@@ -5,35 +5,101 @@
 #include "tracer.hpp"
 #include "../src/chip8/simplemem.hpp"
 #include "../src/chip8/chip8.hpp"
+#include "../src/host/recompiler.hpp"
+#include "../src/host/rewind.hpp"
+#include "../src/host/movie.hpp"
+#include "../src/host/netplay.hpp"
 #include <vector>
 
+// Enough decode cache entries to cover the whole 12-bit address space.
+#define DECODE_CACHE_SIZE 0x1000
+
+// Rewind history: at most 5 minutes, in at most 8MB. A frame's delta is
+// usually well under 100 bytes, so the frame limit is normally hit first.
+#define REWIND_FRAMES (5*60*60)
+#define REWIND_ARENA_SIZE (8*1024*1024)
+
+// Where to listen for the other player, where to find them, and the keys this
+// player owns, as a mask.
+struct NetOptions {
+    uint16_t LocalPort;
+    const char *PeerHost;
+    uint16_t PeerPort;
+    uint16_t Keys;
+};
+
 struct RunnerProgram {
     const uint8_t *code;
     uint16_t size;
     const char* name;
-    bool shiftquirk;
+    Config config;
+    AotFn aot;
 };
 
 class Chip8Runner {
     void pollEvents();
 
     SimpleMemory mMemory;
+    X86Recompiler mRecompiler;
+    bool mRecompile;
     SDL_Renderer *mSDL_Renderer;
     SDLRender mRender;
-    //ConsoleTracer mTracer;
-    Tracer mTracer;
-    Chip8 mEmu;
+    Framebuffer mFramebuffer;
+    // To trace, swap in ConsoleTracer here and in mEmu's type.
+    NullTracer mTracer;
+    Chip8<SDLRender, Memory, NullTracer> mEmu;
+    DecodedOp mDecodedOps[DECODE_CACHE_SIZE];
+    DecodeCache mDecodeCache;
     std::vector<RunnerProgram> mPrograms;
     uint8_t mProgramIndex = 0;
+
+    // A state is pushed every frame, and popped while rewinding.
+    std::vector<uint8_t> mRewindArena;
+    std::vector<RewindEntry> mRewindEntries;
+    RewindBuffer mRewind;
+    SaveState mSave;
+    bool mRewinding = false;
+
+    // Where to record the next program loaded, if anywhere, and the
+    // recording in progress.
+    const char *mRecordPath;
+    MovieWriter mMovie;
+
+    // Frames to run ahead of the real state, and the snapshot to go back to.
+    uint8_t mRunAhead;
+    SaveState mAhead;
+
+    // Netplay: the session, whether the program has started, and a snapshot
+    // from the start of each frame that might be rolled back to.
+    NetSession mNet;
+    NetOptions mNetOptions;
+    bool mNetPlay;
+    bool mNetStarted = false;
+    std::vector<SaveState> mNetStates;
     
     void handleKeyEvent(SDL_Scancode code, bool pressed);
     bool tick();
+    void saveFrame();
+    void rewindFrame();
+    void runAhead();
+    bool netFrame();
+    void netStep(uint32_t frame);
+    void runSteps(uint16_t count);
+    bool waitingForInput();
     void nextProgram();
     void prevProgram();
     void loadEmu();
+    void startRecording(const RunnerProgram &pgm, uint32_t seed);
 
     public:
-    Chip8Runner(SDL_Renderer *renderer, std::vector<RunnerProgram> programs);
+    // If recompile is true, instructions are run through the X86Recompiler
+    // where possible. If record is set, the first program's inputs are
+    // recorded there, as a movie for the headless player. Recording always
+    // uses the interpreter, which is what the player uses. If runAhead is
+    // set, the screen shows that many frames ahead (see runAhead). If net is
+    // set, the first program is played against a peer (see netFrame), and
+    // recording, rewinding, running ahead and switching programs are off.
+    Chip8Runner(SDL_Renderer *renderer, std::vector<RunnerProgram> programs, bool recompile = false, const char *record = NULL, uint8_t runAhead = 0, const NetOptions *net = NULL);
     ~Chip8Runner();
     void run();
 };
@@ -1,12 +1,41 @@
 #include "SDL2/SDL.h"
 #include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
 #include "chip8runner.hpp"
 #define PROGMEM
 #include "program.h"
 #include "programs.h"
 #include <thread>
+#include <algorithm>
 
 int main(int argc, char* argv[]) {
+    // --recompile runs programs through the x86-64 recompiler.
+    // --record FILE records the first program's inputs to FILE.
+    // --runahead N shows the screen N frames ahead, to cut input latency.
+    // --program NAME starts with the program called NAME.
+    // --net PORT HOST HOSTPORT plays against HOST, listening on PORT.
+    // --keys MASK sets the keys this player owns in netplay, in hex.
+    bool recompile = false;
+    const char *record = NULL;
+    uint8_t runAhead = 0;
+    const char *program = NULL;
+    NetOptions net = {};
+    bool netPlay = false;
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--recompile") == 0) recompile = true;
+        if(strcmp(argv[i], "--record") == 0 && i + 1 < argc) record = argv[++i];
+        if(strcmp(argv[i], "--runahead") == 0 && i + 1 < argc) runAhead = atoi(argv[++i]);
+        if(strcmp(argv[i], "--program") == 0 && i + 1 < argc) program = argv[++i];
+        if(strcmp(argv[i], "--net") == 0 && i + 3 < argc) {
+            net.LocalPort = atoi(argv[++i]);
+            net.PeerHost = argv[++i];
+            net.PeerPort = atoi(argv[++i]);
+            netPlay = true;
+        }
+        if(strcmp(argv[i], "--keys") == 0 && i + 1 < argc) net.Keys = strtoul(argv[++i], NULL, 16);
+    }
+
     SDL_Init(SDL_INIT_VIDEO);       
 
     SDL_Window *window = SDL_CreateWindow(
@@ -28,10 +57,19 @@ int main(int argc, char* argv[]) {
     std::vector<RunnerProgram> pgms(PROGRAM_COUNT);
     for(int i = 0; i < PROGRAM_COUNT; i++) {
         const Program* pgm = &programs[i];
-        pgms[i] = (RunnerProgram){pgm->code, pgm->size, pgm->name, pgm->shiftquirk};
+        pgms[i] = (RunnerProgram){pgm->code, pgm->size, pgm->name, pgm->config, pgm->aot};
+    }
+    if(program) {
+        int i = 0;
+        while(i < PROGRAM_COUNT && strcmp(pgms[i].name, program) != 0) i++;
+        if(i == PROGRAM_COUNT) {
+            printf("No program called %s\n", program);
+            return -1;
+        }
+        std::rotate(pgms.begin(), pgms.begin() + i, pgms.end());
     }
 
-    Chip8Runner runner(renderer, pgms);
+    Chip8Runner runner(renderer, pgms, recompile, record, runAhead, netPlay ? &net : NULL);
     runner.run();
 
     SDL_DestroyWindow(window);
@@ -1,11 +1,14 @@
 #include "render.hpp"
-#include <cstdlib>
-#include <ctime> 
 #include <algorithm>
 #include "stdio.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 SDLRender::SDLRender(SDL_Renderer *renderer) :mRenderer(renderer) {
-    srand(time(NULL));
     mTexture = SDL_CreateTexture(
             mRenderer,
             SDL_PIXELFORMAT_ARGB8888, 
@@ -25,64 +28,84 @@ void SDLRender::setMode(RenderMode mode) {
     mWidth = mode == SCHIP8 ? 128 : 64;
     mHeight = mode == CHIP8 ? 32 : 64;
     SDL_RenderSetLogicalSize(mRenderer, mWidth, mHeight);
+    mForcePresent = true;
 }
 
-bool SDLRender::drawPixel(uint8_t x, uint8_t y, bool drawVal) {
-    // Don't draw out of bounds.
-    if(x < 0 || y < 0 || x >= mWidth || y >= mHeight) return false;
-
-    bool wasOn = mPixelData[y][x] == 0xFFFFFFFF;
-    bool on = wasOn ^ drawVal;
-    mPixelData[y][x] = on ? 0xFFFFFFFF : 0;
-
-    return wasOn & !on;
+// Expand the 8 pixels in each byte of a framebuffer row to white or black ARGB
+// pixels. Each pixel's bit is isolated with a mask, and compared with the mask
+// to give all ones or all zeros.
+static void expandRow(const uint8_t *row, uint32_t *out) {
+#if defined(__AVX2__)
+    const __m256i mask = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1);
+    for(uint8_t i = 0; i < FRAMEBUFFER_ROW_BYTES; i++, out += 8) {
+        __m256i bits = _mm256_and_si256(_mm256_set1_epi32(row[i]), mask);
+        _mm256_storeu_si256((__m256i*)out, _mm256_cmpeq_epi32(bits, mask));
+    }
+#elif defined(__SSE2__)
+    const __m128i hiMask = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+    const __m128i loMask = _mm_setr_epi32(8, 4, 2, 1);
+    for(uint8_t i = 0; i < FRAMEBUFFER_ROW_BYTES; i++, out += 8) {
+        __m128i byte = _mm_set1_epi32(row[i]);
+        __m128i hi = _mm_and_si128(byte, hiMask);
+        __m128i lo = _mm_and_si128(byte, loMask);
+        _mm_storeu_si128((__m128i*)out, _mm_cmpeq_epi32(hi, hiMask));
+        _mm_storeu_si128((__m128i*)(out + 4), _mm_cmpeq_epi32(lo, loMask));
+    }
+#else
+    for(uint8_t i = 0; i < FRAMEBUFFER_ROW_BYTES; i++) {
+        for(uint8_t bit = 0x80; bit; bit >>= 1) {
+            *out++ = row[i] & bit ? 0xFFFFFFFF : 0;
+        }
+    }
+#endif
 }
 
-void SDLRender::clear() {
-    SDL_Rect full = {0,0,mWidth, mHeight};
-    memset(mPixelData, 0, 128*64*4);
+void SDLRender::present(const Framebuffer &framebuffer) {
+    if(!mPresenting) return;
+    if(!framebuffer.dirty() && !mForcePresent) {
+        // The last frame is still on the screen.
+        return;
+    }
+    // Expand the stored rows that changed, and upload the span covering them.
+    // Streaming textures are write-only when locked, so the expanded rows are
+    // kept here, and whole span is copied from them.
+    int first = -1, last = -1;
+    for(uint8_t i = 0; i < FRAMEBUFFER_HEIGHT; i++) {
+        if(!framebuffer.storedRowDirty(i)) continue;
+        expandRow(framebuffer.storedRow(i), mPixels[i]);
+        if(first < 0) first = i;
+        last = i;
+    }
+    if(first >= 0) {
+        SDL_Rect span = {0, first, FRAMEBUFFER_WIDTH, last - first + 1};
+        SDL_UpdateTexture(mTexture, &span, mPixels[first], sizeof(mPixels[0]));
+    }
+    mForcePresent = false;
+
+    // The texture holds the rows as stored, so the screen starts at the
+    // framebuffer's origin, and wraps around to the top of the texture.
+    uint8_t origin = framebuffer.origin();
+    uint8_t top = std::min(FRAMEBUFFER_HEIGHT - origin, (int)mHeight);
+    SDL_Rect src = {0, origin, mWidth, top};
+    SDL_Rect dst = {0, 0, mWidth, top};
+    SDL_RenderCopy(mRenderer, mTexture, &src, &dst);
+    if(top < mHeight) {
+        src = {0, 0, mWidth, mHeight - top};
+        dst = {0, top, mWidth, mHeight - top};
+        SDL_RenderCopy(mRenderer, mTexture, &src, &dst);
+    }
+    SDL_RenderPresent(mRenderer);
 }
 
 void SDLRender::render() {
-    // TODO - Handle scroll during texture copy via offsets,
-    // so that scrollleft/scrollright don't have to move data.
-    SDL_Rect full = {0,0,128,64};
-    uint32_t *outPixels;
-    int pitch;
-    SDL_LockTexture(mTexture, &full, (void**)&outPixels, &pitch);
-    memcpy(outPixels, mPixelData, pitch*64);
-    SDL_UnlockTexture(mTexture);
-
     SDL_Rect src = {0, 0, mWidth, mHeight};
     SDL_RenderCopy(mRenderer, mTexture, &src, NULL);
     SDL_RenderPresent(mRenderer);
 }
 
-void SDLRender::scrollDown(uint8_t amt) {
-    memmove(&mPixelData[amt][0], &mPixelData[0][0], 128*(60-4)*4);
-}
-
-void SDLRender::scrollLeft() {
-    for(uint8_t y = 0; y < mHeight; y++) {
-        memmove(&mPixelData[y][0], &mPixelData[y][4],124 *4);
-        memset(&mPixelData[y][mWidth-4], 0, 4*4);
-    }
-}
-
-void SDLRender::scrollRight() {
-    for(uint8_t y = 0; y < mHeight; y++) {
-        memmove(&mPixelData[y][4], &mPixelData[y][0],124 *4);
-        memset(&mPixelData[y][0], 0, 4*4);
-    }
-}
-
 void SDLRender::beep(uint8_t dur) {
 }
 
-uint8_t SDLRender::random() {
-    return rand();
-}
-
 uint16_t SDLRender::buttons() {
     return mButtons;
 }
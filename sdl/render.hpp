@@ -1,49 +1,64 @@
 #pragma once
 
 #include "../src/chip8/render.hpp"
+#include "../src/chip8/framebuffer.hpp"
 #include "SDL2/SDL.h"
 
-class SDLRender : public Render {
-    // Button map 0-F little-endian
+class SDLRender final : public Render {
+    // Button map 0-F little-endian: the keys held, and the buttons the
+    // emulator sees. They're the same, except in netplay, where the buttons
+    // come from both players.
+    uint16_t mKeys = 0;
     uint16_t mButtons = 0;
 
     SDL_Renderer *mRenderer;
 
-    uint8_t mScrollX = 0;
-    uint8_t mScrollY = 0;
-
     uint8_t mWidth = 64;
     uint8_t mHeight = 32;
 
-    // Store pixel data ourselves, so we can do XORing, and maybe other cool things like
-    // phosphor decay. It's not trivial to read the pixel data back from the SDL_Texture.
-    uint32_t mPixelData[64][128];
+    // The framebuffer expanded to ARGB, one row per stored framebuffer row.
+    // Only rows that changed are expanded again and uploaded to the texture.
+    uint32_t mPixels[FRAMEBUFFER_HEIGHT][FRAMEBUFFER_WIDTH];
+
+    // Present even if the framebuffer hasn't changed, because the window
+    // needs redrawing.
+    bool mForcePresent = true;
+
+    // When false, present does nothing.
+    bool mPresenting = true;
 
     public:
     SDLRender(SDL_Renderer* renderer);
     ~SDLRender();
     virtual void render();
 
+    // Drawing is done by the emulator, in a Framebuffer. This copies it to
+    // the texture and renders it.
+    virtual void present(const Framebuffer &framebuffer);
+
     virtual void setMode(RenderMode mode);
 
-    virtual bool drawPixel(uint8_t x, uint8_t y, bool drawVal);
-    virtual void clear();
+    // Draw the screen again at the next present, whether or not anything
+    // changed. Used when the window is exposed or resized.
+    void redraw() { mForcePresent = true; }
+
+    // Stop or start presenting frames, so frames can be run without being
+    // shown.
+    void setPresenting(bool presenting) { mPresenting = presenting; }
 
     // 128 x 64 texture. Clipped for Chip8 mode.
     SDL_Texture * mTexture;
 
     void setKeyState(uint8_t button, bool pressed) { 
         uint16_t mask = 1 << button;
-        mButtons = pressed ? mButtons | mask : mButtons & ~mask;
+        mKeys = pressed ? mKeys | mask : mKeys & ~mask;
+        mButtons = mKeys;
     }
 
-    // SUPER CHIP-8
-    virtual void scrollDown(uint8_t amt);
-    virtual void scrollLeft();
-    virtual void scrollRight();
+    uint16_t keys() { return mKeys; }
+    void setButtons(uint16_t buttons) { mButtons = buttons; }
 
     // Non-drawing rendering
     virtual void beep(uint8_t dur);
-    virtual uint8_t random();
     virtual uint16_t buttons();
 };
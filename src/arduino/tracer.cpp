@@ -27,7 +27,7 @@ void SerialTracer::exec(const EmuState &state, const Config &config) {
             FS, F("]  I="),
             X16, state.Index,
 
-            FS, F(" shiftquirks="), X8, config.ShiftQuirk,
+            FS, F(" quirks="), X8, quirkMask(config),
             '\r', '\n',
             DONE
         );
@@ -3,7 +3,7 @@
 #include "PrintHelper.hpp"
 #include <Arduino.h>
 
-class SerialTracer : public Tracer {
+class SerialTracer final : public Tracer {
     PrintHelper mPrint;
 
     const __FlashStringHelper* errorMessage(ErrorType errorType);
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "state.hpp"
+
+#include <stdint.h>
+
+// Ahead-of-time compiled code for a program, as generated by `tools/dump.py
+// --aot`.
+//
+// The function runs the compiled block starting at state.NextPC, if there is
+// one, leaving the state as if the interpreter had just executed the block's
+// last instruction. It returns the number of instructions that were run, or 0
+// if there's no compiled block at that address, in which case the interpreter
+// should run the instruction instead.
+//
+// Blocks never cross a 256-byte page, so the emulator can stop using them for
+// any page that the program writes to.
+typedef uint8_t (*AotFn)(EmuState &state);
@@ -0,0 +1,949 @@
+#pragma once
+
+// Implementation of the Chip8 class template. This is included by chip8.hpp;
+// don't include it directly.
+
+#include "string.h"
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+Chip8<RenderT, MemoryT, TracerT>::Chip8(
+    RenderT &render, 
+    MemoryT &mem, 
+    TracerT &tracer
+) : mRender(render), mMemory(mem), mTracer(tracer), mFramebuffer(NULL), mDecodeCache(NULL), mAot(NULL), mWrittenPages(0), mIdleRejected(0) {
+    SetConfig(Config());
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+void Chip8<RenderT, MemoryT, TracerT>::SetConfig(Config config) {
+    mConfig = config;
+    mQuirks = quirkMask(config);
+#ifdef __AVR__
+    // There's no room in flash for a copy of the interpreter per profile.
+    useProfile<QUIRKS_RUNTIME>();
+#else
+    switch(mQuirks) {
+        case QUIRKS_NONE: useProfile<QUIRKS_NONE>(); break;
+        case QUIRKS_SHIFT: useProfile<QUIRKS_SHIFT>(); break;
+        case QUIRKS_VIP: useProfile<QUIRKS_VIP>(); break;
+        case QUIRKS_SCHIP: useProfile<QUIRKS_SCHIP>(); break;
+        case QUIRKS_XOCHIP: useProfile<QUIRKS_XOCHIP>(); break;
+        default: useProfile<QUIRKS_RUNTIME>(); break;
+    }
+#endif
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline void Chip8<RenderT, MemoryT, TracerT>::useProfile() {
+    mStep = &Chip8::step<Q>;
+    mRun = &Chip8::run<Q>;
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline bool Chip8<RenderT, MemoryT, TracerT>::quirk(uint8_t quirk) {
+    return ((Q & QUIRKS_RUNTIME) ? mQuirks : Q) & quirk;
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+void Chip8<RenderT, MemoryT, TracerT>::SetSeed(uint32_t seed) {
+    mState.Random = seed ? seed : 1;
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+void Chip8<RenderT, MemoryT, TracerT>::SetFramebuffer(Framebuffer *framebuffer) {
+    mFramebuffer = framebuffer;
+    if(mFramebuffer) mFramebuffer->setMode(mRender.mode());
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+void Chip8<RenderT, MemoryT, TracerT>::SetDecodeCache(DecodeCache *cache) {
+    mDecodeCache = cache;
+    if(mDecodeCache) mDecodeCache->reset();
+}
+
+// Written pages are only forgotten here, not on Reset: the memory might still
+// hold the program's writes when it restarts.
+template<typename RenderT, typename MemoryT, typename TracerT>
+void Chip8<RenderT, MemoryT, TracerT>::SetAot(AotFn aot) {
+    mAot = aot;
+    mWrittenPages = 0;
+}
+
+// Reset all registers and flags for the emulator instance, clear the memory, and begin running.
+template<typename RenderT, typename MemoryT, typename TracerT>
+void Chip8<RenderT, MemoryT, TracerT>::Reset() {
+    // Carry on with the same random numbers, rather than repeating them
+    // every time the program restarts.
+    uint32_t random = mState.Random;
+    mState = EmuState();
+    mState.Random = random;
+    mState.Running = true;
+    // The program may have been (re)loaded since we last ran.
+    if(mDecodeCache) mDecodeCache->reset();
+    mIdleRejected = 0;
+    clearScreen();
+    setMode(CHIP8);
+    mRender.beep(0);
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+bool Chip8<RenderT, MemoryT, TracerT>::Snapshot(SaveState &save) {
+    if(!mFramebuffer || !mMemory.save(save.RAM)) return false;
+    save.Version = SAVESTATE_VERSION;
+    save.State = mState;
+    save.Configuration = mConfig;
+    save.WrittenPages = mWrittenPages;
+    save.Mode = mRender.mode();
+    save.Display = *mFramebuffer;
+    return true;
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+bool Chip8<RenderT, MemoryT, TracerT>::Restore(const SaveState &save) {
+    if(save.Version != SAVESTATE_VERSION || !mFramebuffer) return false;
+    uint32_t changed;
+    if(!mMemory.restore(save.RAM, changed)) return false;
+    mState = save.State;
+    SetConfig(save.Configuration);
+    mWrittenPages = save.WrittenPages;
+    // The code may have changed underneath decoded instructions in the
+    // restored pages.
+    if(mDecodeCache) {
+        for(uint8_t page = 0; page < SNAPSHOT_PAGES; page++) {
+            if(!(changed & ((uint32_t)1 << page))) continue;
+            uint16_t addr = page * SNAPSHOT_PAGE_SIZE;
+            mDecodeCache->invalidate(addr, SNAPSHOT_PAGE_SIZE / 2);
+            mDecodeCache->invalidate(addr + SNAPSHOT_PAGE_SIZE / 2, SNAPSHOT_PAGE_SIZE / 2);
+        }
+    }
+    mIdleRejected = 0;
+    *mFramebuffer = save.Display;
+    // Anything on the screen may have changed.
+    mFramebuffer->touch();
+    if(mRender.mode() != save.Mode) mRender.setMode(save.Mode);
+    return true;
+}
+
+// Tick updates any state that gets updated at 60Hz by chip-8
+// namely, beep timer and delay timer, and triggers screen draw.
+template<typename RenderT, typename MemoryT, typename TracerT>
+void Chip8<RenderT, MemoryT, TracerT>::Tick() {
+    handleButtons();
+    if(mFramebuffer) {
+        mRender.present(*mFramebuffer);
+        mFramebuffer->clean();
+    } else {
+        mRender.render();
+    }
+    mState.AwaitingDisplay = false;
+    // The timer and keys may have changed, so an idle loop might exit now.
+    // Forget the loop too: the next two passes through it have to run
+    // without a tick in between before it counts as idle again.
+    mState.Idle = false;
+    mState.IdleJump = 0;
+    mTracer.tick(mState, mConfig);
+    if(mState.DelayTimer > 0) {
+        mState.DelayTimer--;
+    }
+}
+
+// Read the button state from the platform provider.
+// If The emulator isn't running because it's waiting for a key, if the key is
+// now pressed, it will be stored in the provided register.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::handleButtons() {
+    // Get platform buttons into the emulator state.
+    mState.Buttons = mRender.buttons();
+    
+    // Handle the 0xFX0A (waitKey) instruction if needed.
+    if (mState.AwaitingKey && mState.Buttons)  {
+        // Find the first pressed button, lower hex value gets priority.
+        uint8_t pressed = 0;
+        uint8_t mask = 0x01;
+        while(mask && ((mState.Buttons & mask) == 0)) {
+            mask <<= 1;
+            pressed++;
+        }
+
+        // Place the pressed button into the destinstaion resgister and
+        // reset waiting flag.
+        mState.V[mState.WaitKeyDest] = pressed;
+        mState.AwaitingKey = false;
+    }
+}
+
+// Expose the internal readWord inline function.
+template<typename RenderT, typename MemoryT, typename TracerT>
+bool Chip8<RenderT, MemoryT, TracerT>::ReadWord(uint16_t addr, uint16_t &result) {
+    return readWord(addr, result);
+}
+
+// Read a 16-bit word from the memory of this Chip8 emulator at the
+// specified address, handling endian byte swap.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline bool Chip8<RenderT, MemoryT, TracerT>::readWord(uint16_t addr, uint16_t &result) {
+    if(!mMemory.read(addr, (uint8_t*)&result, 2)) return false;
+    result = (result >> 8) | (result << 8);
+    return true;
+}
+
+// Write to memory. Any predecoded instructions covering the written range
+// are dropped, so that self-modifying programs see their changes.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline bool Chip8<RenderT, MemoryT, TracerT>::writeMem(uint16_t addr, uint8_t *src, uint8_t size) {
+    if(mDecodeCache) mDecodeCache->invalidate(addr, size);
+    mState.IdleJump = 0;
+    mIdleRejected = 0;
+    uint16_t last = addr + size - 1;
+    for(uint16_t page = addr >> 8; page <= (last >> 8) && page < 16; page++) {
+        mWrittenPages |= 1 << page;
+    }
+    return mMemory.write(addr, src, size);
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline bool Chip8<RenderT, MemoryT, TracerT>::codeWritten(uint16_t addr) {
+    return addr > 0xFFF || (mWrittenPages & (1 << (addr >> 8)));
+}
+
+// Read and execute one Chip8 operation, using the step implementation that
+// SetConfig chose.
+template<typename RenderT, typename MemoryT, typename TracerT>
+ErrorType Chip8<RenderT, MemoryT, TracerT>::Step() {
+#ifdef __AVR__
+    return step<QUIRKS_RUNTIME>();
+#else
+    return (this->*mStep)();
+#endif
+}
+
+// Run a batch of instructions, using the run implementation that SetConfig
+// chose.
+template<typename RenderT, typename MemoryT, typename TracerT>
+RunResult Chip8<RenderT, MemoryT, TracerT>::RunCycles(uint16_t cycles, bool syncDraw) {
+#ifdef __AVR__
+    return run<QUIRKS_RUNTIME>(cycles, syncDraw);
+#else
+    return (this->*mRun)(cycles, syncDraw);
+#endif
+}
+
+// Run a batch of instructions, then do the 60Hz updates. The tick happens even
+// if the batch ended early, so timers keep running while the program waits.
+template<typename RenderT, typename MemoryT, typename TracerT>
+RunResult Chip8<RenderT, MemoryT, TracerT>::RunFrame(uint16_t ipf, bool syncDraw) {
+    RunResult result = RunCycles(ipf, syncDraw);
+    Tick();
+    return result;
+}
+
+// Returns true if the program can't continue until Buttons or Tick is called.
+// The emulator is still considered to be running.
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline bool Chip8<RenderT, MemoryT, TracerT>::waiting() {
+    return mState.AwaitingKey || mState.Idle
+        || (quirk<Q>(QUIRK_DISPLAY_WAIT) && mState.AwaitingDisplay);
+}
+
+// Returns true if inst changes the display: sprite draws, clears, and scrolls.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline bool Chip8<RenderT, MemoryT, TracerT>::drawsToDisplay(uint16_t inst) {
+    if((inst >> 12) == 0xD) return true;
+    if((inst >> 12) != 0x0) return false;
+    return inst == 0x00E0 || inst == 0x0230 || (inst & 0xFFF0) == 0x00C0
+        || inst == 0x00FB || inst == 0x00FC;
+}
+
+// The batch loop behind RunCycles. The running check is done once up front,
+// and the loop only stops for the conditions documented on RunCycles.
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+RunResult Chip8<RenderT, MemoryT, TracerT>::run(uint16_t cycles, bool syncDraw) {
+    RunResult result = {0, NO_ERROR, false, false};
+    if(!mState.Running) {
+        result.Error = STOPPED;
+        return result;
+    }
+
+    while(result.Cycles < cycles && !waiting<Q>()) {
+        uint8_t count;
+        result.Error = execNext<Q>(count);
+        result.Cycles += count;
+        if(result.Error != NO_ERROR) break;
+        // Compiled blocks never draw, so it's fine that this only looks at the
+        // last instruction that ran.
+        if(drawsToDisplay(mState.Instruction)) {
+            result.Drew = true;
+            if(syncDraw) break;
+        }
+    }
+    result.AwaitingKey = mState.AwaitingKey;
+    return result;
+}
+
+// Read and execute one Chip8 operation. Instructions will be read from memory
+// using the provided memory implementation.
+// If an ErrorType other than NO_ERROR is returned, then the PC will be pointing 
+// to the last instruction executed.
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+ErrorType Chip8<RenderT, MemoryT, TracerT>::step() {
+    // Let the caller know that we're not running.
+    if(!mState.Running) return STOPPED;
+
+    // We won't run any instructions while awaiting keys or the display, but
+    // still considered in the running state.
+    if(waiting<Q>()) return NO_ERROR;
+
+    uint8_t count;
+    return execNext<Q>(count);
+}
+
+// Execute the instruction at NextPC (or the compiled block starting there),
+// setting count to the number of instructions that ran.
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline ErrorType Chip8<RenderT, MemoryT, TracerT>::execNext(uint8_t &count) {
+    // Run compiled code for the next instruction if there is any, and the
+    // program hasn't written over it. Compiled blocks don't call the tracer.
+    // Blocks can jump without going through checkIdle, so they also end any
+    // idle loop tracking.
+    if(mAot && !codeWritten(mState.NextPC)) {
+        count = mAot(mState);
+        if(count > 0) {
+            mState.IdleJump = 0;
+            return NO_ERROR;
+        }
+    }
+    count = 1;
+
+    mState.PC = mState.NextPC;
+
+    // If there's a decode cache, and the instruction has already been decoded,
+    // we can skip fetching it entirely. Otherwise fetch it, and remember the
+    // decoded result for next time.
+    DecodedOp *op = mDecodeCache ? mDecodeCache->lookup(mState.PC) : NULL;
+    if(op && op->kind != OP_UNDECODED) {
+        mState.Instruction = op->inst;
+    } else {
+        if(!ReadWord(mState.PC, mState.Instruction)) {
+            mState.Running = false;
+            return BAD_FETCH;
+        }
+        if(op) decode(mState.Instruction, *op);
+    }
+
+    // Increment PC now, none of the instructions depend on its value. 
+    // This way, we don't need to keep track of whether or not the 
+    // instruction resulted in a jump.
+    mState.NextPC += 2;
+
+    mTracer.exec(mState, mConfig);
+    ErrorType error = op ? execDecoded<Q>(*op) : exec<Q>(mState.Instruction);
+    mTracer.execFinished(mState, mConfig);
+    if(error != NO_ERROR) {
+        mState.Running = false;
+        mTracer.error(error, mState, mConfig);
+    }
+    return error;
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline ErrorType Chip8<RenderT, MemoryT, TracerT>::exec(uint16_t inst) {
+    // Dispatch to the instruction group based on the top nybble.
+    switch (inst >> 12) {
+        case 0x0: return groupSys(inst);
+        case 0x1: groupJump(inst); break;
+        case 0x2: return groupCall(inst);
+        case 0x3: groupSeImm(inst); break;
+        case 0x4: groupSneImm(inst); break;
+        case 0x5: groupSeReg(inst); break;
+        case 0x6: groupLdImm(inst); break;
+        case 0x7: groupAddImm(inst); break;
+        case 0x8: return groupALU<Q>(inst);
+        case 0x9: groupSneReg(inst); break;
+        case 0xA: groupLdiImm(inst); break;
+        case 0xB: groupJpV0Index<Q>(inst); break;
+        case 0xC: groupRand(inst); break;
+        case 0xD: return groupGraphics<Q>(inst);
+        case 0xE: return groupKeyboard(inst);
+        case 0xF: return groupLoad<Q>(inst);
+    }
+    return NO_ERROR;
+}
+
+// Execute an instruction that has already been decoded. This does the same
+// work as exec, but dispatches with one flat switch, using the operands that
+// were extracted at decode time.
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline ErrorType Chip8<RenderT, MemoryT, TracerT>::execDecoded(const DecodedOp &op) {
+    switch(op.kind) {
+        case OP_CLS: clearScreen(); break;
+        case OP_RET: return ret();
+        case OP_SCROLL_DOWN: scrollDown(imm4(op.inst)); break;
+        case OP_SCROLL_RIGHT: scrollRight(); break;
+        case OP_SCROLL_LEFT: scrollLeft(); break;
+        case OP_EXIT: mState.Running = false; return STOPPED;
+        case OP_LORES: setSuperhires(false); break;
+        case OP_HIRES: setSuperhires(true); break;
+        case OP_JP: groupJump(op.inst); break;
+        case OP_CALL: return groupCall(op.inst);
+        case OP_SE_IMM: groupSeImm(op.inst); break;
+        case OP_SNE_IMM: groupSneImm(op.inst); break;
+        case OP_SE_REG: groupSeReg(op.inst); break;
+        case OP_LD_IMM: groupLdImm(op.inst); break;
+        case OP_ADD_IMM: groupAddImm(op.inst); break;
+        case OP_SNE_REG: groupSneReg(op.inst); break;
+        case OP_LDI: groupLdiImm(op.inst); break;
+        case OP_JP_V0: groupJpV0Index<Q>(op.inst); break;
+        case OP_RAND: groupRand(op.inst); break;
+        case OP_ALU_LD: aluLd(op.x, op.y); break;
+        case OP_ALU_OR: aluOr<Q>(op.x, op.y); break;
+        case OP_ALU_AND: aluAnd<Q>(op.x, op.y); break;
+        case OP_ALU_XOR: aluXor<Q>(op.x, op.y); break;
+        case OP_ALU_ADD: aluAdd(op.x, op.y); break;
+        case OP_ALU_SUB: aluSub(op.x, op.y); break;
+        case OP_ALU_SHR: aluShr<Q>(op.x, op.y); break;
+        case OP_ALU_SUBN: aluSubn(op.x, op.y); break;
+        case OP_ALU_SHL: aluShl<Q>(op.x, op.y); break;
+        case OP_DRAW: return groupGraphics<Q>(op.inst);
+        case OP_SKP:
+        case OP_SKNP: return groupKeyboard(op.inst);
+        case OP_LD_DT: readDT(op.x); break;
+        case OP_WAIT_K: waitK(op.x); break;
+        case OP_SET_DT: setDT(op.x); break;
+        case OP_BEEP: makeBeep(op.x); break;
+        case OP_ADD_I: addI(op.x); break;
+        case OP_LDI_FONT: ldiFont(op.x); break;
+        case OP_LDI_HIFONT: ldiHiFont(op.x); break;
+        case OP_BCD: return writeBCD(op.x);
+        case OP_STR_REG: return strReg<Q>(op.x);
+        case OP_LD_REG: return ldReg<Q>(op.x);
+        case OP_STR_R: strR(op.x); break;
+        case OP_LD_R: ldR(op.x); break;
+        default: return UNIMPLEMENTED_INSTRUCTION;
+    }
+    return NO_ERROR;
+}
+
+// Screen operations go to the framebuffer if there is one, and the Render
+// otherwise. The Render always tracks the mode.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::clearScreen() {
+    if(mFramebuffer) mFramebuffer->clear(); else mRender.clear();
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::setMode(RenderMode mode) {
+    mRender.setMode(mode);
+    if(mFramebuffer) mFramebuffer->setMode(mode);
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::scrollDown(uint8_t amt) {
+    if(mFramebuffer) mFramebuffer->scrollDown(amt); else mRender.scrollDown(amt);
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::scrollLeft() {
+    if(mFramebuffer) mFramebuffer->scrollLeft(); else mRender.scrollLeft();
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::scrollRight() {
+    if(mFramebuffer) mFramebuffer->scrollRight(); else mRender.scrollRight();
+}
+
+// 0x0XXX - System
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline ErrorType Chip8<RenderT, MemoryT, TracerT>::groupSys(uint16_t inst) {
+    switch(inst >> 4) {
+        case 0x00C: scrollDown(inst&0x000F); break;
+        default: switch(inst) {
+            case 0x00E0: clearScreen(); break;
+            case 0x00EE: return ret();
+            case 0x00FB: scrollRight(); break; // SCHIP8
+            case 0x00FC: scrollLeft(); break;  // SCHIP8
+            case 0x00FD: mState.Running = false; return STOPPED;
+            case 0x00FE: setSuperhires(false); break;
+            case 0x00FF: setSuperhires(true); break;
+            case 0x0230: clearScreen(); break; // Hi-Res variant
+            default: return UNIMPLEMENTED_INSTRUCTION; 
+        }
+    }
+    return NO_ERROR;
+}
+
+// 0x00EE - Return from the most recently called subroutine.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline ErrorType Chip8<RenderT, MemoryT, TracerT>::ret() {
+    if(mState.StackPointer == 0) {
+        return STACK_UNDERFLOW;
+    }
+    mState.StackPointer--;
+    mState.NextPC = mState.Stack[mState.StackPointer];
+    mState.IdleJump = 0;
+    return NO_ERROR;
+}
+
+// 0x00FE/0x00FF - Enabled/Disable SChip8 hires mode.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::setSuperhires(bool enabled) {
+    setMode(enabled ? SCHIP8 : CHIP8);
+}
+
+// 0x1nnn jump
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::groupJump(uint16_t inst) {
+    // Hack for handling original 64x64 Hi-Res mode
+    // HiRes ML routines were at 200-248, hi-res
+    // programs started at 0x2c0. They always start
+    // with a jump to 0x0260, which runs a setup routine
+    // in chip8/native asm:
+    // * 6012 61be a200 f155
+    //   Rewrite the first chip8 instruction to be a jump to 0x12be
+    // * A series of reads of 0x200 space followed by writes to 0x000 
+    //   space, presumably copying some native 1802 code contained in
+    //   the Chip8 rom into the emulator space.
+    // * It ends with 0x02ac at program address 0x02ac, 
+    //   which jumps to a native RCA1802 routine at that location. 
+    //   That routine eventually returns to running the chip8
+    //   program. So in the emulator. 
+    if(mState.PC == 0x200 && inst == 0x1260) {
+        // Do what the ML code would do. 
+        setMode(CHIP8HI);
+        // Re-enter 0x0200, which is just going to jump to 0x02be.
+        mState.NextPC = 0x02c0;
+    } else {
+        mState.NextPC = imm12(inst);
+        checkIdle();
+        return;
+    }
+    mState.IdleJump = 0;
+}
+
+// Idle loop detection. Games often wait for the delay timer or a key with a
+// short loop like 0xFX07, 0x3X00, 0x1nnn. If a loop only reads the timer and
+// keys and skips, and a full pass through it changes nothing, then every pass
+// until the next tick will do the same, so we can stop running it until then.
+//
+// A pass starts and ends with the loop's backward jump. Any other jump, call,
+// or return forgets the jump, so between two consecutive takes of the same
+// jump execution stayed inside the loop. Reading the timer is the only way the
+// loop can change a register; readDT flags that.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::checkIdle() {
+    uint16_t jump = mState.PC;
+    uint16_t start = mState.NextPC;
+    if(start > jump || jump - start > IDLE_LOOP_MAX_BYTES || jump == mIdleRejected) {
+        mState.IdleJump = 0;
+        return;
+    }
+
+    if(mState.IdleJump == jump) {
+        // A full pass with nothing changed.
+        if(!mState.IdleChanged) mState.Idle = true;
+    } else if(!idleLoopBody(start, jump)) {
+        mIdleRejected = jump;
+        mState.IdleJump = 0;
+        return;
+    }
+    mState.IdleJump = jump;
+    mState.IdleChanged = false;
+}
+
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline bool Chip8<RenderT, MemoryT, TracerT>::idleLoopBody(uint16_t start, uint16_t end) {
+    for(uint16_t addr = start; addr < end; addr += 2) {
+        uint16_t inst;
+        if(!readWord(addr, inst)) return false;
+        switch(inst >> 12) {
+            case 0x3: case 0x4: break;
+            case 0x5: case 0x9: if(imm4(inst) != 0) return false; break;
+            case 0xE: if(imm8(inst) != 0x9E && imm8(inst) != 0xA1) return false; break;
+            case 0xF: if(imm8(inst) != 0x07) return false; break;
+            default: return false;
+        }
+    }
+    return true;
+}
+
+// 02nnn call
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline ErrorType Chip8<RenderT, MemoryT, TracerT>::groupCall(uint16_t inst) {
+    // What does original interpreter do?
+    if(mState.StackPointer >= 16) {
+        return STACK_OVERFLOW;
+    }
+    mState.Stack[mState.StackPointer++] = mState.NextPC;
+    mState.NextPC = imm12(inst);
+    mState.IdleJump = 0;
+    return NO_ERROR;
+}
+
+// 0x3Xnn skip if equal immediate
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::groupSeImm(uint16_t inst) {
+    if(mState.V[x(inst)] == imm8(inst)) {
+        mState.NextPC+=2;
+    }
+}
+
+// 0x4Xnn skip if not equal immediate
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::groupSneImm(uint16_t inst) {
+    if(mState.V[x(inst)] != imm8(inst)) {
+        mState.NextPC+=2;
+    }
+}
+
+// 0x5XY0 skip if two registers hold equal values
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::groupSeReg(uint16_t inst) {
+    if(mState.V[x(inst)] == mState.V[y(inst)]) {
+        mState.NextPC+=2;
+    }
+}
+
+// 0x6Xnn - Load immediate
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::groupLdImm(uint16_t inst) {
+    mState.V[x(inst)] = (uint8_t)inst;
+}
+
+// 0x7Xnn - add immediate
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::groupAddImm(uint16_t inst) {
+    mState.V[x(inst)] += imm8(inst);
+    // no VF carry indication? The documentation doesn't specify any.
+}
+
+// 0x8XYx - ALU Group
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+ErrorType Chip8<RenderT, MemoryT, TracerT>::groupALU(uint16_t inst) {
+    switch (inst&0xF) {
+        case 0x0: aluLd(x(inst), y(inst)); break;
+        case 0x1: aluOr<Q>(x(inst), y(inst)); break;
+        case 0x2: aluAnd<Q>(x(inst), y(inst)); break;
+        case 0x3: aluXor<Q>(x(inst), y(inst)); break;
+        case 0x4: aluAdd(x(inst), y(inst)); break;
+        case 0x5: aluSub(x(inst), y(inst)); break;
+        case 0x6: aluShr<Q>(x(inst), y(inst)); break;
+        case 0x7: aluSubn(x(inst), y(inst)); break;
+        case 0xE: aluShl<Q>(x(inst), y(inst)); break;
+        default: return UNIMPLEMENTED_INSTRUCTION;
+    }
+    return NO_ERROR;
+}
+
+// 0x8XY0   VX = Vy
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::aluLd(uint8_t x, uint8_t y) { mState.V[x] = mState.V[y]; }
+
+// 0x8XY1   VX = VX OR VY
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline void Chip8<RenderT, MemoryT, TracerT>::aluOr(uint8_t x, uint8_t y) {
+    mState.V[x] = mState.V[x] | mState.V[y];
+    if(quirk<Q>(QUIRK_VF_RESET)) mState.V[0xF] = 0;
+}
+
+// 0x8XY2   VX = VX AND XY
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline void Chip8<RenderT, MemoryT, TracerT>::aluAnd(uint8_t x, uint8_t y) {
+    mState.V[x] = mState.V[x] & mState.V[y];
+    if(quirk<Q>(QUIRK_VF_RESET)) mState.V[0xF] = 0;
+}
+
+// 0x8XY3   VX = VX XOR XY
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline void Chip8<RenderT, MemoryT, TracerT>::aluXor(uint8_t x, uint8_t y) {
+    mState.V[x] = mState.V[x] ^ mState.V[y];
+    if(quirk<Q>(QUIRK_VF_RESET)) mState.V[0xF] = 0;
+}
+
+// 0x8XY4   VX = VX + VY, VF = carry
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::aluAdd(uint8_t x, uint8_t y) { 
+    uint16_t result_carry = mState.V[x] + mState.V[y];
+    mState.V[x] = mState.V[x] + mState.V[y]; 
+    mState.V[0xF] = result_carry > 0x00FF ? 1 : 0;
+}
+
+// 0x8XY5   VX = VX - VY, VF = 1 if borrow did not occur
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::aluSub(uint8_t x, uint8_t y) { 
+    // NOTE: some references indicate that VF = 1 if X > y. But it's X >= Y.
+    // That is, VF = 1 if subtraction did not result in a borrow.
+    uint8_t vf = mState.V[x] >= mState.V[y]; 
+    mState.V[x] = mState.V[x] - mState.V[y];
+    mState.V[0xF] = vf;
+}
+
+// 0x8XY6   VX = VX SHR VY, VF = bit shifted out
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline void Chip8<RenderT, MemoryT, TracerT>::aluShr(uint8_t x, uint8_t y) { 
+    uint8_t src = mState.V[quirk<Q>(QUIRK_SHIFT) ? x : y];
+    // Capture vf, but set actual VF register last.
+    uint8_t vf = src&0x01 ? 1 : 0;
+    mState.V[x] = src >> 1;
+    mState.V[0xF] = vf; 
+}
+
+// 0x8XY7   VX = VY - VX, VF = 1 if borrow did not occur
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::aluSubn(uint8_t x, uint8_t y) { 
+    // NOTE: some references indicate that VF = 1 if X > y. But it's X >= Y.
+    // That is, VF = 1 if subtraction did not result in a borrow.
+    uint8_t vf = mState.V[y] >= mState.V[x]; 
+    mState.V[x] = mState.V[y] - mState.V[x];
+    mState.V[0xF] = vf;
+}
+
+// 0x8XY8   VX = VX SHL VY, VF = bit shifted out
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline void Chip8<RenderT, MemoryT, TracerT>::aluShl(uint8_t x, uint8_t y) { 
+    uint8_t src = mState.V[quirk<Q>(QUIRK_SHIFT) ? x : y];
+    uint8_t vf = src&0x80 ? 1 : 0;
+    mState.V[x] = src  << 1;
+    mState.V[0xF] = vf;
+}
+
+// 0x9XYx   Skip if two registers hold inequal values
+template<typename RenderT, typename MemoryT, typename TracerT>
+void Chip8<RenderT, MemoryT, TracerT>::groupSneReg(uint16_t inst) {
+    if(mState.V[x(inst)] != mState.V[y(inst)]) {
+        mState.NextPC+=2;
+    }
+}
+
+//0xAnnn   load index immediate
+template<typename RenderT, typename MemoryT, typename TracerT>
+void Chip8<RenderT, MemoryT, TracerT>::groupLdiImm(uint16_t inst) {
+    mState.Index = imm12(inst);
+}
+
+// 0xBnnn   jump to v[0] + xxx
+// With the jump quirk, it's 0xBXnn, jump to v[x] + Xnn.
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+void Chip8<RenderT, MemoryT, TracerT>::groupJpV0Index(uint16_t inst) {
+    mState.NextPC = mState.V[quirk<Q>(QUIRK_JUMP) ? x(inst) : 0]+imm12(inst);
+    mState.IdleJump = 0;
+}
+
+//0xCXnn   random, with mask.
+template<typename RenderT, typename MemoryT, typename TracerT>
+void Chip8<RenderT, MemoryT, TracerT>::groupRand(uint16_t inst) {
+    mState.V[x(inst)] = nextRandom(mState) & imm8(inst);
+}
+
+//0xDXYL   draw! If you think there's a bug in here, you're probably right.
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+ErrorType Chip8<RenderT, MemoryT, TracerT>::groupGraphics(uint16_t inst) {
+    // The number of lines in the sprite that we should draw.
+    uint8_t rows = imm4(inst);
+    // The size of the screen in the current mode.
+    RenderMode mode = mRender.mode();
+    uint8_t width = mode == SCHIP8 ? 128 : 64;
+    uint8_t height = mode == CHIP8 ? 32 : 64;
+
+    // X, Y location of the sprite, from registers. The location always wraps
+    // onto the screen, whether or not the sprite itself is clipped.
+    uint8_t xc = mState.V[x(inst)] & (width - 1);
+    uint8_t yc = mState.V[y(inst)] & (height - 1);
+
+    // In chip8 mode, we draw 8 columns. 
+    uint8_t cols = 8;
+    // We will be shifting the data left and masking out the 8th MSB
+    uint16_t mask = 0x80;
+
+    // In super hires mode, drawing with rows == 0 triggers 16x16 sprite mode.
+    bool superSprite = rows == 0 && mRender.mode() == SCHIP8;
+
+    if(superSprite) {
+       rows = 16;
+        // We will be shifting the data left and masking out the 16th MSB.
+       mask = 0x8000;
+       cols = 16;
+    }
+
+    // Rows past the bottom edge are clipped, or wrap to the top.
+    if(quirk<Q>(QUIRK_CLIP) && yc + rows > height) rows = height - yc;
+
+    // Collect the data to draw from memory, all at once. Rows of 16x16
+    // sprites are two bytes.
+    uint8_t data[32];
+    uint8_t rowBytes = cols / 8;
+    if(rows > 0 && !mMemory.read(mState.Index, data, rows * rowBytes)) return BAD_READ;
+
+    // Clear the collision flag.
+    mState.V[0xF] = 0;
+
+    // Draw row-by-row
+    for(int row = 0; row < rows; row++) {
+        uint8_t py = yc + row;
+        if(py >= height) py -= height;
+
+        uint16_t rowData = superSprite ? (data[row*2] << 8) | data[row*2+1] : data[row];
+
+        // With a framebuffer, the whole row is drawn at once.
+        if(mFramebuffer) {
+            mState.V[0xF] |= mFramebuffer->drawRow(xc, py, rowData, cols, quirk<Q>(QUIRK_CLIP));
+            continue;
+        }
+
+        for(int col = 0; col < cols; col++) {
+            // Likewise for columns past the right edge.
+            uint8_t px = xc + col;
+            if(px >= width) {
+                if(quirk<Q>(QUIRK_CLIP)) break;
+                px -= width;
+            }
+            bool on = rowData&mask;
+
+            // Draw the pixel
+            mState.V[0xF] |= mRender.drawPixel(px,py, on);
+            rowData<<=1;
+
+        }
+    }
+
+    // The COSMAC VIP waited for the display to refresh before drawing, so a
+    // program can draw at most once per tick.
+    if(quirk<Q>(QUIRK_DISPLAY_WAIT)) mState.AwaitingDisplay = true;
+    return NO_ERROR;
+}
+
+// 0xEX9E / 0xEXA1 - skip if key pressed/not pressed
+template<typename RenderT, typename MemoryT, typename TracerT>
+ErrorType Chip8<RenderT, MemoryT, TracerT>::groupKeyboard(uint16_t inst) {
+    uint8_t key = mState.V[x(inst)];
+    uint16_t mask = 0x01 << key;
+    switch(imm8(inst)) {
+        case 0x9E:
+            if(mState.Buttons & mask) {
+                mState.NextPC += 2;
+            }
+            break;
+        case 0xA1:
+            if(!(mState.Buttons & mask)) {
+                mState.NextPC += 2;
+            }
+            break;
+        default: return UNIMPLEMENTED_INSTRUCTION;
+    }
+    return NO_ERROR;
+}
+
+// 0xFnnn - Load to various internal registers
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+ErrorType Chip8<RenderT, MemoryT, TracerT>::groupLoad(uint16_t inst) {
+    switch(inst&0xFF) {
+        case 0x07: readDT(x(inst)); break;
+        case 0xA: waitK(x(inst)); break;
+        case 0x15: setDT(x(inst)); break;
+        case 0x18: makeBeep(x(inst)); break;
+        case 0x1E: addI(x(inst)); break;
+        case 0x29: ldiFont(x(inst)); break;
+        case 0x30: ldiHiFont(x(inst)); break;
+        case 0x33: return writeBCD(x(inst));
+        case 0x55: return strReg<Q>(x(inst));
+        case 0x65: return ldReg<Q>(x(inst));
+        case 0x75: strR(x(inst)); break;
+        case 0x85: ldR(x(inst)); break;
+        default: return UNIMPLEMENTED_INSTRUCTION;
+    }
+    return NO_ERROR;
+}
+
+// 0xFX07 - Read delay timer into VX.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::readDT(uint8_t into) {
+    if(mState.V[into] != mState.DelayTimer) mState.IdleChanged = true;
+    mState.V[into] = mState.DelayTimer;
+}
+
+// 0xFX0A - Pause execution until a key is pressed.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::waitK(uint8_t into) {
+    mState.AwaitingKey = true;
+    mState.WaitKeyDest = into;
+}
+
+// 0xFX15 - Set the delay timer to value in VX.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::setDT(uint8_t from) { mState.DelayTimer = mState.V[from]; }
+
+// 0xFX18 - Beep for the duration in VX.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::makeBeep(uint16_t durReg) { 
+    mRender.beep(mState.V[durReg]);
+}
+
+// 0xFX1E - Add VX to I
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::addI(uint8_t from) { mState.Index += mState.V[from]; }
+
+// 0xFX29 - Load low-res font character in VX
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::ldiFont(uint8_t from) { mState.Index = 5 * mState.V[from]; }
+
+// 0xFX30 - Load hi-res font character in VX. It appears immediately after the low-res font.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::ldiHiFont(uint8_t from) { mState.Index = 0x10*5 + (10 * mState.V[from]); }
+
+// 0xFX33 - Write binary coded decimal encoding of VX to memory pointed to by I.
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline ErrorType Chip8<RenderT, MemoryT, TracerT>::writeBCD(uint8_t from) {
+    uint8_t val = mState.V[from];
+    uint8_t vals[3] = {(uint8_t)(val/100), (uint8_t)((val/10)%10), (uint8_t)(val%10)};
+    return writeMem(mState.Index, vals, 3) ? NO_ERROR : OUT_OF_MEMORY;
+}
+
+// 0xFX55 - Store V0-VX starting at I.
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline ErrorType Chip8<RenderT, MemoryT, TracerT>::strReg(uint8_t upto) {
+    if(!writeMem(mState.Index, mState.V, upto+1)) return OUT_OF_MEMORY;
+    if(quirk<Q>(QUIRK_LOAD_STORE)) mState.Index += upto+1;
+    return NO_ERROR;
+}
+
+// 0xFX65 - Read into V0-VX starting at I.
+template<typename RenderT, typename MemoryT, typename TracerT>
+template<uint8_t Q>
+inline ErrorType Chip8<RenderT, MemoryT, TracerT>::ldReg(uint8_t upto) {
+    if(!mMemory.read(mState.Index, mState.V, upto+1)) return BAD_READ;
+    if(quirk<Q>(QUIRK_LOAD_STORE)) mState.Index += upto+1;
+    return NO_ERROR;
+}
+
+
+// 0xFX75 - Store registers into special platform storage
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::strR(uint8_t upto) {
+    for(int i = 0; i <= upto; i++) {
+        mState.R[i] = mState.V[i];
+    }
+}
+
+// 0xFX85 - Read registers from special platform storage
+template<typename RenderT, typename MemoryT, typename TracerT>
+inline void Chip8<RenderT, MemoryT, TracerT>::ldR(uint8_t upto) {
+    for(int i = 0; i <= upto; i++) {
+        mState.V[i] = mState.R[i];
+    }
+}
@@ -6,23 +6,61 @@
 #include "chip8-reg.hpp"
 #include "tracer.hpp"
 #include "config.hpp"
+#include "decode.hpp"
+#include "aot.hpp"
+#include "framebuffer.hpp"
+#include "runresult.hpp"
+#include "savestate.hpp"
 
 #include <stdint.h>
 
+// The longest loop, in bytes from its first instruction to the jump that
+// closes it, that's checked for idling.
+#define IDLE_LOOP_MAX_BYTES 16
+
+// The emulator is a template over the platform's Render, Memory and Tracer
+// types. Chip8<> calls them through their virtual interfaces; instantiating it
+// with the platform's own final classes lets the compiler call (and inline)
+// them directly, and makes NullTracer hooks disappear entirely.
+template<typename RenderT = Render, typename MemoryT = Memory, typename TracerT = Tracer>
 class Chip8 {
     // Rendering implementation from platform.
-    Render &mRender;
+    RenderT &mRender;
 
     // Memory implementation from platform.
-    Memory &mMemory;
+    MemoryT &mMemory;
 
     // Tracer implementation.
-    Tracer &mTracer;
+    TracerT &mTracer;
 
     EmuState mState;
     
     Config mConfig;
 
+    // The quirks enabled in mConfig, as a mask of Quirk values.
+    uint8_t mQuirks;
+
+    // The step and run implementations for the configured quirks, chosen by
+    // SetConfig.
+    ErrorType (Chip8::*mStep)();
+    RunResult (Chip8::*mRun)(uint16_t cycles, bool syncDraw);
+
+    // Optional framebuffer to draw into, provided by the platform.
+    Framebuffer *mFramebuffer;
+
+    // Optional cache of predecoded instructions, provided by the platform.
+    DecodeCache *mDecodeCache;
+
+    // Optional ahead-of-time compiled code for the loaded program.
+    AotFn mAot;
+
+    // One bit per 256-byte page of the 4K address space, set once the program
+    // writes to the page. Compiled code isn't used for written pages.
+    uint16_t mWrittenPages;
+
+    // Returns true if the program may have modified the code at addr.
+    inline bool codeWritten(uint16_t addr);
+
     // read buttons and handle any updates
     inline void handleButtons();
 
@@ -31,10 +69,52 @@ class Chip8 {
 
     inline bool readWord(uint16_t addr, uint16_t &result);
 
+    // Write to memory, invalidating any predecoded instructions that the
+    // write touches.
+    inline bool writeMem(uint16_t addr, uint8_t *src, uint8_t size);
+
+    // Returns true if quirk is enabled. Q is the QuirkProfile that the
+    // calling dispatch path was specialized for, which makes this a constant
+    // for every profile except QUIRKS_RUNTIME.
+    template<uint8_t Q> inline bool quirk(uint8_t quirk);
+
+    // Use the step and run implementations specialized for the quirk
+    // profile Q.
+    template<uint8_t Q> inline void useProfile();
+
+    // Returns true if the program can't continue until a key is pressed, or
+    // the next tick.
+    template<uint8_t Q> inline bool waiting();
+
+    // Returns true if the instruction changes the display.
+    inline bool drawsToDisplay(uint16_t inst);
+
+    // The last short backward jump found to close a loop that can't be idle,
+    // so we don't keep checking it.
+    uint16_t mIdleRejected;
+
+    // Called after taking a 1nnn jump, to look for idle loops.
+    inline void checkIdle();
+
+    // Returns true if the code from start up to end only reads the delay
+    // timer and keys, and skips.
+    inline bool idleLoopBody(uint16_t start, uint16_t end);
+
+    // Step and RunCycles, specialized for the quirk profile Q.
+    template<uint8_t Q> ErrorType step();
+    template<uint8_t Q> RunResult run(uint16_t cycles, bool syncDraw);
+
+    // Fetch and execute the next instruction, or compiled block. count is
+    // set to the number of instructions that ran.
+    template<uint8_t Q> inline ErrorType execNext(uint8_t &count);
+
     // execute a single fetched chip8 instruction
     // If the instruction results in an error, the type will be passed via the
     // provided errorType param.
-    ErrorType exec(uint16_t inst);
+    template<uint8_t Q> ErrorType exec(uint16_t inst);
+
+    // execute a single predecoded chip8 instruction. 
+    template<uint8_t Q> ErrorType execDecoded(const DecodedOp &op);
 
     // Instruction groups.
     
@@ -63,7 +143,7 @@ class Chip8 {
     inline void groupAddImm(uint16_t);
 
     // 0x8XYx - ALU Group
-    inline ErrorType groupALU(uint16_t);
+    template<uint8_t Q> inline ErrorType groupALU(uint16_t);
 
     // 0x9XYx   Skip if two registers hold inequal values
     inline void groupSneReg(uint16_t);
@@ -71,22 +151,29 @@ class Chip8 {
     //0xAnnn   load index immediate
     inline void groupLdiImm(uint16_t);
 
-    // 0xBnnn   jump to I + xxx
-    inline void groupJpV0Index(uint16_t);
+    // 0xBnnn   jump to V0 + nnn (or VX + nnn, with the jump quirk)
+    template<uint8_t Q> inline void groupJpV0Index(uint16_t);
 
     //0xCXnn   random, with mask.
     inline void groupRand(uint16_t);
     
     //0xDXYL   draw! If you think there's a bug in here, you're probably right.
-    inline ErrorType groupGraphics(uint16_t);
+    template<uint8_t Q> inline ErrorType groupGraphics(uint16_t);
 
     // 0xEX9E / 0xEXA1 - skip if key pressed/not pressed
     inline ErrorType groupKeyboard(uint16_t);
 
     // 0xFnnn - Load to various internal registers
-    inline ErrorType groupLoad(uint16_t);
+    template<uint8_t Q> inline ErrorType groupLoad(uint16_t);
 
 
+    // Screen operations, on the framebuffer or the Render.
+    inline void clearScreen();
+    inline void setMode(RenderMode mode);
+    inline void scrollDown(uint8_t amt);
+    inline void scrollLeft();
+    inline void scrollRight();
+
     // Instruction Sub-Methods
     
     // System group 0x0xxx
@@ -102,13 +189,13 @@ class Chip8 {
     inline void aluLd(uint8_t x, uint8_t y);
 
     // 0x8XY2   VX = VX AND XY
-    inline void aluOr(uint8_t x, uint8_t y);
+    template<uint8_t Q> inline void aluOr(uint8_t x, uint8_t y);
     
     // 0x8XY1   VX = VX OR VY
-    inline void aluAnd(uint8_t x, uint8_t y);
+    template<uint8_t Q> inline void aluAnd(uint8_t x, uint8_t y);
 
     // 0x8XY3   VX = VX XOR XY
-    inline void aluXor(uint8_t x, uint8_t y);
+    template<uint8_t Q> inline void aluXor(uint8_t x, uint8_t y);
 
     // 0x8XY4   VX = VX + VY, VF = carry
     inline void aluAdd(uint8_t x, uint8_t y);
@@ -117,13 +204,13 @@ class Chip8 {
     inline void aluSub(uint8_t x, uint8_t y);
     
     // 0x8XY6   VX = VX SHR VY, VF = bit shifted out
-    inline void aluShr(uint8_t x, uint8_t y);
+    template<uint8_t Q> inline void aluShr(uint8_t x, uint8_t y);
 
     // 0x8XY7   VX = VY - VX, VF = 1 if borrow did not occur
     inline void aluSubn(uint8_t x, uint8_t y);
 
     // 0x8XY8   VX = VX SHL VY, VF = bit shifted out
-    inline void aluShl(uint8_t x, uint8_t y);
+    template<uint8_t Q> inline void aluShl(uint8_t x, uint8_t y);
 
 
     // Load group 0xFxxx
@@ -153,10 +240,10 @@ class Chip8 {
     inline ErrorType writeBCD(uint8_t);
 
     // 0xFX55 - Store V0-VX starting at I.
-    inline ErrorType strReg(uint8_t);
+    template<uint8_t Q> inline ErrorType strReg(uint8_t);
 
     // 0xFX65 - Read into V0-VX starting at I.
-    inline ErrorType ldReg(uint8_t);
+    template<uint8_t Q> inline ErrorType ldReg(uint8_t);
 
     // 0xFX75 - Store registers into special platform storage
     // For example, "RPL" registers that were used in the original
@@ -172,21 +259,54 @@ class Chip8 {
     public:
         // create a new Chip8 emulator with the provided renderer and memory
         // implementations.
-        Chip8(Render &render, Memory &memory, Tracer &tracer);
+        Chip8(RenderT &render, MemoryT &memory, TracerT &tracer);
 
         // Reset all registers and flags for the emulator instance, clear the memory,
         // and begin running.
         void Reset();
 
-        void SetConfig(Config config) { mConfig = config; }
+        // Set the quirks to emulate. This also selects the dispatch path
+        // that's specialized for them, so they cost nothing as instructions
+        // run.
+        void SetConfig(Config config);
         Config GetConfig() { return mConfig; }
 
+        // Seed the random number generator used by 0xCXnn. Reset doesn't
+        // reseed it, so to reproduce a run, seed it before the Reset that
+        // starts the program.
+        void SetSeed(uint32_t seed);
+
+        // Draw into the provided framebuffer, and present it to the Render
+        // each tick, instead of drawing through Render::drawPixel. Pass NULL
+        // to go back to drawing through the Render.
+        void SetFramebuffer(Framebuffer *framebuffer);
+
+        // Use the provided cache to hold predecoded instructions, so that
+        // instructions that run repeatedly are only fetched and decoded once.
+        // Pass NULL to stop using a cache.
+        void SetDecodeCache(DecodeCache *cache);
+
+        // Use the provided ahead-of-time compiled code (see aot.hpp) for the
+        // program that's about to run, or NULL for none. Call this whenever a
+        // new program is loaded.
+        void SetAot(AotFn aot);
+
         // Read and execute one Chip8 operation. Instructions will be read from memory
         // using the provided memory implementation.
         // Returns ErrorType, which includes information about running the instruction, like
         // whether it resulted in an error or a halt.
         ErrorType Step();
 
+        // Run up to cycles instructions in one go. This stops early on an
+        // error or halt, when the program starts waiting for a key (0xFX0A)
+        // or the display, and, if syncDraw is set, right after the first
+        // instruction that draws. A compiled block always runs to its end, so
+        // with ahead-of-time code the batch can run slightly over.
+        RunResult RunCycles(uint16_t cycles, bool syncDraw = false);
+
+        // Run a frame: RunCycles(ipf, syncDraw), followed by Tick.
+        RunResult RunFrame(uint16_t ipf, bool syncDraw = false);
+
         // Accept a bitmask of buttons that are pressed. The value will update the
         // internal button state of the emulator. If the emulator is waiting for a
         // keypress, that state will be detected here, and execution will continue.
@@ -204,4 +324,34 @@ class Chip8 {
         bool ReadWord(uint16_t addr, uint16_t &result);
 
         const EmuState& State() { return mState; }
+
+        // Mutable access to the emulator state, for execution engines that
+        // run instructions outside of Step (like the host recompiler). They
+        // are responsible for keeping the state consistent with what Step
+        // would have produced.
+        EmuState& MutableState() { return mState; }
+
+        // Save everything about the running program into save: the state,
+        // config, display and memory. This needs a framebuffer (see
+        // SetFramebuffer), and a Memory that can be saved; returns false
+        // without them.
+        //
+        // Reusing the same SaveState makes this cheap enough to do every
+        // frame: memory pages that haven't changed since it was last used
+        // aren't copied again.
+        bool Snapshot(SaveState &save);
+
+        // Put the emulator back the way it was when save was made. Returns
+        // false if save is from an incompatible version, or can't be
+        // restored here, in which case nothing is changed. Only the memory
+        // pages that differ from save are copied, and only decoded
+        // instructions in those pages are dropped, so restoring every frame
+        // is cheap too. A Memory that caches code (like the host
+        // recompiler) should drop the changed pages' code in restore.
+        bool Restore(const SaveState &save);
 };
+
+#include "chip8-impl.hpp"
+
+// The virtual-interface form is compiled once, in chip8.cpp.
+extern template class Chip8<Render, Memory, Tracer>;
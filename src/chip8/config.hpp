@@ -1,6 +1,70 @@
 #pragma once
+#include <stdint.h>
 
+// Behavior differences between Chip8 implementations that some programs depend
+// on. With everything off, the emulator behaves as it always has.
 struct Config {
+    // 0x8XY6/0x8XYE shift VX in place, ignoring VY (CHIP-48/SCHIP).
     bool ShiftQuirk;
+
+    // 0x8XY1/0x8XY2/0x8XY3 reset VF to 0 (COSMAC VIP).
+    bool VfResetQuirk;
+
+    // 0xFX55/0xFX65 leave I pointing just past the last register that was
+    // stored or loaded (COSMAC VIP).
+    bool LoadStoreQuirk;
+
+    // 0xBXNN jumps to XNN + VX, instead of XNN + V0 (CHIP-48/SCHIP).
+    bool JumpQuirk;
+
+    // Sprites are clipped at the edges of the screen, instead of wrapping
+    // around to the other side.
+    bool ClipQuirk;
+
+    // 0xDXYN waits for the display, so at most one sprite is drawn each 60Hz
+    // tick (COSMAC VIP).
+    bool DisplayWaitQuirk;
+};
+
+// The same quirks as a bitmask.
+enum Quirk : uint8_t {
+    QUIRK_SHIFT = 0x01,
+    QUIRK_VF_RESET = 0x02,
+    QUIRK_LOAD_STORE = 0x04,
+    QUIRK_JUMP = 0x08,
+    QUIRK_CLIP = 0x10,
+    QUIRK_DISPLAY_WAIT = 0x20,
+};
+
+// Combinations of quirks that the emulator has a specialized dispatch path
+// for. Any other combination is handled by checking the quirks as instructions
+// run (QUIRKS_RUNTIME).
+enum QuirkProfile : uint8_t {
+    // No quirks; this emulator's default behavior.
+    QUIRKS_NONE = 0,
+
+    // Default behavior with in-place shifts, for older shiftquirk programs.
+    QUIRKS_SHIFT = QUIRK_SHIFT,
+
+    // The original COSMAC VIP interpreter.
+    QUIRKS_VIP = QUIRK_VF_RESET | QUIRK_LOAD_STORE | QUIRK_CLIP | QUIRK_DISPLAY_WAIT,
+
+    // SCHIP 1.1, as on the HP-48.
+    QUIRKS_SCHIP = QUIRK_SHIFT | QUIRK_JUMP | QUIRK_CLIP,
+
+    // XO-CHIP.
+    QUIRKS_XOCHIP = QUIRK_LOAD_STORE,
+
+    // Not a profile: quirks are read from the configuration at run time.
+    QUIRKS_RUNTIME = 0x80,
 };
 
+// Return the quirks enabled in config as a mask of Quirk values.
+inline uint8_t quirkMask(const Config &config) {
+    return (config.ShiftQuirk ? QUIRK_SHIFT : 0)
+        | (config.VfResetQuirk ? QUIRK_VF_RESET : 0)
+        | (config.LoadStoreQuirk ? QUIRK_LOAD_STORE : 0)
+        | (config.JumpQuirk ? QUIRK_JUMP : 0)
+        | (config.ClipQuirk ? QUIRK_CLIP : 0)
+        | (config.DisplayWaitQuirk ? QUIRK_DISPLAY_WAIT : 0);
+}
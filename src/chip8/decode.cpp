@@ -0,0 +1,113 @@
+#include "decode.hpp"
+#include "chip8-reg.hpp"
+#include "string.h"
+
+DecodeCache::DecodeCache(DecodedOp *ops, uint16_t size) :
+    mOps(ops),
+    mSize(size) {
+    reset();
+}
+
+void DecodeCache::reset() {
+    memset(mOps, 0, mSize * sizeof(DecodedOp));
+}
+
+// An instruction starting at addr-1 also covers addr, so start one entry
+// early.
+void DecodeCache::invalidate(uint16_t addr, uint8_t size) {
+    uint16_t first = addr > 0 ? addr - 1 : 0;
+    uint16_t end = addr + size;
+    if(end > mSize) end = mSize;
+    for(uint16_t i = first; i < end; i++) {
+        mOps[i].kind = OP_UNDECODED;
+    }
+}
+
+// 0x0XXX - System
+static uint8_t decodeSys(uint16_t inst) {
+    if((inst >> 4) == 0x00C) return OP_SCROLL_DOWN;
+    switch(inst) {
+        case 0x00E0: return OP_CLS;
+        case 0x00EE: return OP_RET;
+        case 0x00FB: return OP_SCROLL_RIGHT;
+        case 0x00FC: return OP_SCROLL_LEFT;
+        case 0x00FD: return OP_EXIT;
+        case 0x00FE: return OP_LORES;
+        case 0x00FF: return OP_HIRES;
+        case 0x0230: return OP_CLS; // Hi-Res variant
+    }
+    return OP_INVALID;
+}
+
+// 0x8XYx - ALU Group
+static uint8_t decodeALU(uint16_t inst) {
+    switch(inst&0xF) {
+        case 0x0: return OP_ALU_LD;
+        case 0x1: return OP_ALU_OR;
+        case 0x2: return OP_ALU_AND;
+        case 0x3: return OP_ALU_XOR;
+        case 0x4: return OP_ALU_ADD;
+        case 0x5: return OP_ALU_SUB;
+        case 0x6: return OP_ALU_SHR;
+        case 0x7: return OP_ALU_SUBN;
+        case 0xE: return OP_ALU_SHL;
+    }
+    return OP_INVALID;
+}
+
+// 0xEX9E / 0xEXA1 - skip if key pressed/not pressed
+static uint8_t decodeKeyboard(uint16_t inst) {
+    switch(imm8(inst)) {
+        case 0x9E: return OP_SKP;
+        case 0xA1: return OP_SKNP;
+    }
+    return OP_INVALID;
+}
+
+// 0xFnnn - Load to various internal registers
+static uint8_t decodeLoad(uint16_t inst) {
+    switch(imm8(inst)) {
+        case 0x07: return OP_LD_DT;
+        case 0x0A: return OP_WAIT_K;
+        case 0x15: return OP_SET_DT;
+        case 0x18: return OP_BEEP;
+        case 0x1E: return OP_ADD_I;
+        case 0x29: return OP_LDI_FONT;
+        case 0x30: return OP_LDI_HIFONT;
+        case 0x33: return OP_BCD;
+        case 0x55: return OP_STR_REG;
+        case 0x65: return OP_LD_REG;
+        case 0x75: return OP_STR_R;
+        case 0x85: return OP_LD_R;
+    }
+    return OP_INVALID;
+}
+
+static uint8_t decodeKind(uint16_t inst) {
+    switch(inst >> 12) {
+        case 0x0: return decodeSys(inst);
+        case 0x1: return OP_JP;
+        case 0x2: return OP_CALL;
+        case 0x3: return OP_SE_IMM;
+        case 0x4: return OP_SNE_IMM;
+        case 0x5: return OP_SE_REG;
+        case 0x6: return OP_LD_IMM;
+        case 0x7: return OP_ADD_IMM;
+        case 0x8: return decodeALU(inst);
+        case 0x9: return OP_SNE_REG;
+        case 0xA: return OP_LDI;
+        case 0xB: return OP_JP_V0;
+        case 0xC: return OP_RAND;
+        case 0xD: return OP_DRAW;
+        case 0xE: return decodeKeyboard(inst);
+        case 0xF: return decodeLoad(inst);
+    }
+    return OP_INVALID;
+}
+
+void decode(uint16_t inst, DecodedOp &op) {
+    op.kind = decodeKind(inst);
+    op.x = x(inst);
+    op.y = y(inst);
+    op.inst = inst;
+}
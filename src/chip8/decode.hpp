@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Identifies the operation a decoded instruction performs. The values are
+// dense, so executing a decoded instruction is a single flat switch instead of
+// the nested group dispatch done for raw instruction words.
+enum OpKind {
+    // The cache entry hasn't been decoded yet (or was invalidated).
+    OP_UNDECODED = 0,
+
+    // 0x0XXX - System
+    OP_CLS, OP_RET, OP_SCROLL_DOWN, OP_SCROLL_RIGHT, OP_SCROLL_LEFT, OP_EXIT,
+    OP_LORES, OP_HIRES,
+
+    // 0x1nnn - 0xCXnn
+    OP_JP, OP_CALL, OP_SE_IMM, OP_SNE_IMM, OP_SE_REG, OP_LD_IMM, OP_ADD_IMM,
+    OP_SNE_REG, OP_LDI, OP_JP_V0, OP_RAND,
+
+    // 0x8XYx - ALU
+    OP_ALU_LD, OP_ALU_OR, OP_ALU_AND, OP_ALU_XOR, OP_ALU_ADD, OP_ALU_SUB,
+    OP_ALU_SHR, OP_ALU_SUBN, OP_ALU_SHL,
+
+    // 0xDXYN, 0xEXxx
+    OP_DRAW, OP_SKP, OP_SKNP,
+
+    // 0xFXxx - Load
+    OP_LD_DT, OP_WAIT_K, OP_SET_DT, OP_BEEP, OP_ADD_I, OP_LDI_FONT,
+    OP_LDI_HIFONT, OP_BCD, OP_STR_REG, OP_LD_REG, OP_STR_R, OP_LD_R,
+
+    // Anything we don't know how to execute.
+    OP_INVALID
+};
+
+// A single predecoded instruction: the operation to run, plus its register
+// operands pulled out of the instruction word. The raw word is kept for the
+// immediate values and for tracers.
+struct DecodedOp {
+    uint8_t kind;
+    uint8_t x;
+    uint8_t y;
+    uint16_t inst;
+};
+
+// Decode the provided instruction word into op.
+void decode(uint16_t inst, DecodedOp &op);
+
+// A cache of decoded instructions, indexed by address.
+//
+// Like SlabMemory, the storage is provided by the platform, since only hosts
+// with plenty of RAM can afford an entry for each address. Addresses beyond the
+// provided size are simply never cached.
+//
+// The emulator invalidates entries whenever it writes to memory, so
+// self-modifying programs keep working.
+class DecodeCache {
+    DecodedOp *mOps;
+
+    uint16_t mSize;
+
+    public:
+        // Create a DecodeCache using the provided pointer to a contiguous
+        // memory region that will be treated as an array of size entries, one
+        // for each address starting at 0.
+        DecodeCache(DecodedOp *ops, uint16_t size);
+
+        // Invalidate every entry.
+        void reset();
+
+        // Invalidate any entries whose instruction overlaps the size bytes
+        // starting at addr.
+        void invalidate(uint16_t addr, uint8_t size);
+
+        // Returns the entry for addr, or NULL if addr isn't covered by the
+        // cache. The entry might not be decoded yet.
+        DecodedOp* lookup(uint16_t addr) { return addr < mSize ? &mOps[addr] : NULL; }
+};
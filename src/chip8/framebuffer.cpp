@@ -0,0 +1,77 @@
+#include "framebuffer.hpp"
+
+#include "string.h"
+
+Framebuffer::Framebuffer() {
+    setMode(CHIP8);
+    clear();
+}
+
+void Framebuffer::setMode(RenderMode mode) {
+    mWidth = mode == SCHIP8 ? 128 : 64;
+    mHeight = mode == CHIP8 ? 32 : 64;
+    mDirty = ~(uint64_t)0;
+}
+
+void Framebuffer::clear() {
+    memset(mRows, 0, sizeof(mRows));
+    mOrigin = 0;
+    mDirty = ~(uint64_t)0;
+}
+
+bool Framebuffer::drawRow(uint8_t x, uint8_t y, uint16_t bits, uint8_t count, bool clip) {
+    // Line the sprite row up with the bytes of the screen row: bit 31 of the
+    // window is the first pixel of the byte that x falls in. A 16 pixel
+    // sprite that isn't byte aligned covers 3 bytes.
+    uint32_t window = (uint32_t)bits << (32 - count - (x & 7));
+    uint8_t rowBytes = mWidth / 8;
+    uint8_t col = x >> 3;
+    uint8_t *row = mRows[stored(y)];
+    uint8_t collision = 0;
+    for(uint8_t i = 0; i < 3 && window; i++, col++, window <<= 8) {
+        if(col >= rowBytes) {
+            if(clip) break;
+            col -= rowBytes;
+        }
+        uint8_t data = window >> 24;
+        collision |= row[col] & data;
+        row[col] ^= data;
+    }
+    markDirty(stored(y));
+    return collision;
+}
+
+// Move the origin up, so every row moves down without being copied, and clear
+// the rows that come into view at the top.
+void Framebuffer::scrollDown(uint8_t amt) {
+    if(amt > mHeight) amt = mHeight;
+    mOrigin = (mOrigin - amt) & (FRAMEBUFFER_HEIGHT - 1);
+    for(uint8_t y = 0; y < amt; y++) {
+        memset(mRows[stored(y)], 0, FRAMEBUFFER_ROW_BYTES);
+        markDirty(stored(y));
+    }
+}
+
+void Framebuffer::scrollLeft() {
+    uint8_t rowBytes = mWidth / 8;
+    for(uint8_t y = 0; y < mHeight; y++) {
+        uint8_t *row = mRows[stored(y)];
+        for(uint8_t i = 0; i < rowBytes - 1; i++) {
+            row[i] = (row[i] << 4) | (row[i + 1] >> 4);
+        }
+        row[rowBytes - 1] <<= 4;
+        markDirty(stored(y));
+    }
+}
+
+void Framebuffer::scrollRight() {
+    uint8_t rowBytes = mWidth / 8;
+    for(uint8_t y = 0; y < mHeight; y++) {
+        uint8_t *row = mRows[stored(y)];
+        for(uint8_t i = rowBytes - 1; i > 0; i--) {
+            row[i] = (row[i] >> 4) | (row[i - 1] << 4);
+        }
+        row[0] >>= 4;
+        markDirty(stored(y));
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "render.hpp"
+
+#include <stdint.h>
+
+// Large enough for the SCHIP8 hi-res mode. The lower resolution modes use the
+// top left corner.
+#define FRAMEBUFFER_WIDTH 128
+#define FRAMEBUFFER_HEIGHT 64
+#define FRAMEBUFFER_ROW_BYTES (FRAMEBUFFER_WIDTH / 8)
+
+// A 1 bit per pixel copy of the screen, kept by the emulator.
+//
+// Rows hold 8 pixels per byte, with the leftmost pixel in the most significant
+// bit. Sprites are drawn a whole row at a time by shifting and masking,
+// instead of a pixel at a time, and a Render just has to present the finished
+// buffer (see Render::present).
+//
+// The stored rows are a ring: the screen starts at the stored row origin(),
+// and continues downwards, wrapping around after the last stored row.
+// Scrolling down just moves the origin up and clears the rows that appear, so
+// the rows that moved don't have to be copied, or presented again.
+//
+// Each stored row has a dirty bit, set whenever the row changes. The emulator
+// clears them after each present, so a Render can skip rows (or whole frames)
+// that haven't changed.
+//
+// It takes 1K of RAM, which is too much for the Arduboy, so it's optional: the
+// platform provides it with Chip8::SetFramebuffer. Without one, the emulator
+// draws through Render::drawPixel.
+class Framebuffer {
+    uint8_t mRows[FRAMEBUFFER_HEIGHT][FRAMEBUFFER_ROW_BYTES];
+
+    // The stored row shown at the top of the screen.
+    uint8_t mOrigin;
+
+    // One bit per stored row, set when the row changes.
+    uint64_t mDirty;
+
+    // Size of the screen in the current mode.
+    uint8_t mWidth;
+    uint8_t mHeight;
+
+    // The stored row index for screen row y.
+    uint8_t stored(uint8_t y) const { return (mOrigin + y) & (FRAMEBUFFER_HEIGHT - 1); }
+
+    void markDirty(uint8_t storedRow) { mDirty |= (uint64_t)1 << storedRow; }
+
+    public:
+        Framebuffer();
+
+        // Switch to the screen size of mode. The contents are kept.
+        void setMode(RenderMode mode);
+
+        uint8_t width() const { return mWidth; }
+        uint8_t height() const { return mHeight; }
+
+        // Turn off every pixel.
+        void clear();
+
+        // XOR count bits of sprite data (at most 16, most significant first)
+        // onto row y, starting at column x. x and y must be on the screen.
+        // Pixels past the right edge wrap around to the left, or are clipped
+        // if clip is set. Returns true if any pixel was turned off.
+        bool drawRow(uint8_t x, uint8_t y, uint16_t bits, uint8_t count, bool clip);
+
+        // Scroll the screen down amt rows.
+        void scrollDown(uint8_t amt);
+
+        // Scroll the screen left 4 columns.
+        void scrollLeft();
+
+        // Scroll the screen right 4 columns.
+        void scrollRight();
+
+        // The FRAMEBUFFER_ROW_BYTES bytes of screen row y.
+        const uint8_t* row(uint8_t y) const { return mRows[stored(y)]; }
+
+        // Returns true if the pixel at x, y is on.
+        bool pixel(uint8_t x, uint8_t y) const {
+            return row(y)[x >> 3] & (0x80 >> (x & 7));
+        }
+
+        // Access to the rows as stored, for renders that want to follow the
+        // origin themselves rather than copying rows around when scrolling.
+        uint8_t origin() const { return mOrigin; }
+        const uint8_t* storedRow(uint8_t i) const { return mRows[i]; }
+        bool storedRowDirty(uint8_t i) const { return mDirty & ((uint64_t)1 << i); }
+
+        // Returns true if anything changed since the last call to clean.
+        bool dirty() const { return mDirty != 0; }
+
+        // Clear the dirty bits, once the changes have been presented.
+        void clean() { mDirty = 0; }
+
+        // Set every dirty bit, so the whole screen is presented again.
+        void touch() { mDirty = ~(uint64_t)0; }
+};
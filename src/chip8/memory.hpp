@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 
+struct MemorySnapshot;
+
 // Platforms should implement these methods to provide the needed memory
 // read/write behavior for the platform. For platforms with more than 4k, this
 // may be as simple as reading and writing from a single array.
@@ -19,4 +21,12 @@ class Memory {
         // underlying implementation can't allocate enough memory to satisfy the 
         // write, false is returned. Some data may have been written.
         virtual bool write(uint16_t addr, uint8_t *src, uint8_t size) = 0;
+
+        // Save the memory contents into snapshot, or put them back the way
+        // they were when snapshot was saved. restore sets changed to a mask
+        // of the SNAPSHOT_PAGE_SIZE pages it changed, so anything cached
+        // from the rest can be kept. Memory that can't be saved returns
+        // false.
+        virtual bool save(MemorySnapshot &snapshot) { return false; }
+        virtual bool restore(const MemorySnapshot &snapshot, uint32_t &changed) { return false; }
 };
@@ -3,17 +3,23 @@
 
 enum RenderMode { CHIP8, CHIP8HI, SCHIP8 };
 
+class Framebuffer;
+
 // These methods need to be implemented to provide the drawing, sound, and
-// random functionality that the Chip8 engine needs.
+// input functionality that the Chip8 engine needs.
 //
 // Also includes a hook for any special exit behavior.
+//
+// If the platform gives the emulator a Framebuffer, the emulator draws into
+// that, and calls present instead of render. drawPixel, clear, and the
+// scrolling methods are then never called, so they don't need implementing.
 class Render {
     protected: 
     RenderMode mMode;
 
     public:
     // if it should trigger a collision, return true.
-    virtual bool drawPixel(uint8_t x, uint8_t y, bool drawVal) = 0;
+    virtual bool drawPixel(uint8_t x, uint8_t y, bool drawVal) { return false; }
 
     // set the resolution mode
     virtual void setMode(RenderMode mode) { mMode = mode; }
@@ -24,20 +30,23 @@ class Render {
     // draw the screen
     virtual void render() = 0;
 
+    // draw the screen from the emulator's framebuffer
+    virtual void present(const Framebuffer &framebuffer) { render(); }
+
     // clear the screen
-    virtual void clear() = 0;
+    virtual void clear() {}
     
 
     // SUPER CHIP-8
     
     // scroll the display down the specified number of lines
-    virtual void scrollDown(uint8_t amt) = 0;
+    virtual void scrollDown(uint8_t amt) {}
     
     // scroll the display left 4 columns
-    virtual void scrollLeft() = 0;
+    virtual void scrollLeft() {}
     
     // scroll the display right 4 columns
-    virtual void scrollRight() = 0;
+    virtual void scrollRight() {}
 
 
     // Non-drawing rendering
@@ -45,9 +54,6 @@ class Render {
     // implementations should make a noise for dur/60 seconds.
     virtual void beep(uint8_t dur) = 0;
 
-    // implementations should return a uniform random number from 0 - 0xFF
-    virtual uint8_t random() = 0;
-
     // return the button state. Should return a bitmask for the buttons that have 
     // been pressed, in little-endian order for 0-F.
     virtual uint16_t buttons() = 0;
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "errors.hpp"
+
+#include <stdint.h>
+
+// A summary of a batch of instructions run by Chip8::RunCycles or
+// Chip8::RunFrame.
+struct RunResult {
+    // The number of instructions that were executed.
+    uint16_t Cycles;
+
+    // NO_ERROR, or the error (or STOPPED) that ended the batch.
+    ErrorType Error;
+
+    // True if any instruction changed the display (sprite draw, clear, or
+    // scroll).
+    bool Drew;
+
+    // True if the program is waiting for a keypress (0xFX0A).
+    bool AwaitingKey;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "state.hpp"
+#include "config.hpp"
+#include "render.hpp"
+#include "framebuffer.hpp"
+
+#include <stdint.h>
+
+// Bump this whenever the layout of SaveState, or anything it contains,
+// changes.
+#define SAVESTATE_VERSION 2
+
+// Memory is saved a page at a time, so a snapshot only has to copy the pages
+// that were written since it was last taken.
+#define SNAPSHOT_PAGE_SIZE 256
+
+// Enough pages for 8K of memory.
+#define SNAPSHOT_PAGES 32
+
+// The contents of a Memory, saved by Memory::save.
+//
+// A snapshot remembers the memory it was taken from, and when. Taking it again
+// from the same memory only copies the pages written in between, so the same
+// snapshot should be reused (for example, as a slot in a ring) rather than
+// starting from a fresh one each time.
+struct MemorySnapshot {
+    // The memory this was last taken from, NULL if it never was.
+    const void *Source = NULL;
+
+    // The Source's generation when it was taken (see SimpleMemory).
+    uint32_t Generation = 0;
+
+    uint8_t Pages[SNAPSHOT_PAGES][SNAPSHOT_PAGE_SIZE];
+};
+
+// Everything needed to put a Chip8 instance back where it was, made by
+// Chip8::Snapshot and used by Chip8::Restore.
+//
+// It's about 9K, so it's only for hosts.
+struct SaveState {
+    uint8_t Version = 0;
+
+    EmuState State;
+
+    Config Configuration;
+
+    // The pages the program had written, which compiled code can't be used
+    // for.
+    uint16_t WrittenPages = 0;
+
+    RenderMode Mode = CHIP8;
+
+    Framebuffer Display;
+
+    MemorySnapshot RAM;
+};
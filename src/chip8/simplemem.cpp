@@ -3,7 +3,17 @@
 #include "string.h" 
 #include "font.hpp"
 
+// Counts snapshots taken, so each one knows which pages changed after it. It's
+// shared by every SimpleMemory, so that a snapshot of one that's gone can't
+// pass for a snapshot of a new one at the same address.
+static uint32_t generation = 0;
+
 SimpleMemory::SimpleMemory() {
+    for(uint8_t page = 0; page < SNAPSHOT_PAGES; page++) {
+        mPageGeneration[page] = generation;
+    }
+    // Start from the same contents every time, so runs are reproducible.
+    memset(mMemory, 0, sizeof(mMemory));
     memcpy(mMemory, font, sizeof(font));
     memcpy(mMemory + sizeof(font), fonthi, sizeof(fonthi));
 }
@@ -14,6 +24,7 @@ void SimpleMemory::load(const uint8_t *program, const uint16_t size) {
         end = program+SIZE-0x200;
     }
     memcpy(mMemory+0x200, program, size);
+    touch(0x200, size);
 }
         
 bool SimpleMemory::read(uint16_t addr, uint8_t *dest, uint8_t size) {
@@ -23,5 +34,44 @@ bool SimpleMemory::read(uint16_t addr, uint8_t *dest, uint8_t size) {
         
 bool SimpleMemory::write(uint16_t addr, uint8_t *src, uint8_t size) {
     memcpy(mMemory+addr,src, size);
+    touch(addr, size);
+    return true;
+}
+
+void SimpleMemory::touch(uint16_t addr, uint16_t size) {
+    if(size == 0) return;
+    uint16_t last = (addr + size - 1) / SNAPSHOT_PAGE_SIZE;
+    for(uint16_t page = addr / SNAPSHOT_PAGE_SIZE; page <= last && page < SNAPSHOT_PAGES; page++) {
+        mPageGeneration[page] = generation;
+    }
+}
+
+// A page that hasn't changed since snapshot's generation still matches the
+// snapshot. Saving starts a new generation, so later changes are newer than
+// the snapshot.
+bool SimpleMemory::save(MemorySnapshot &snapshot) {
+    bool all = snapshot.Source != this;
+    for(uint8_t page = 0; page < SNAPSHOT_PAGES; page++) {
+        if(all || mPageGeneration[page] >= snapshot.Generation) {
+            memcpy(snapshot.Pages[page], mMemory + page * SNAPSHOT_PAGE_SIZE, SNAPSHOT_PAGE_SIZE);
+        }
+    }
+    snapshot.Source = this;
+    snapshot.Generation = ++generation;
+    return true;
+}
+
+// Restored pages count as changed, since other snapshots may not match them.
+bool SimpleMemory::restore(const MemorySnapshot &snapshot, uint32_t &changed) {
+    if(snapshot.Source == NULL) return false;
+    bool all = snapshot.Source != this;
+    changed = 0;
+    for(uint8_t page = 0; page < SNAPSHOT_PAGES; page++) {
+        if(all || mPageGeneration[page] >= snapshot.Generation) {
+            memcpy(mMemory + page * SNAPSHOT_PAGE_SIZE, snapshot.Pages[page], SNAPSHOT_PAGE_SIZE);
+            mPageGeneration[page] = generation;
+            changed |= (uint32_t)1 << page;
+        }
+    }
     return true;
 }
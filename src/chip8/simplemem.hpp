@@ -1,13 +1,25 @@
 #include "memory.hpp"
+#include "savestate.hpp"
 
-class SimpleMemory : public Memory {
+class SimpleMemory final : public Memory {
     static const uint16_t SIZE = 8*1024;
     uint8_t mMemory[SIZE];
 
+    // The generation each page was last changed in.
+    uint32_t mPageGeneration[SNAPSHOT_PAGES];
+
+    // Record a change to the size bytes starting at addr.
+    void touch(uint16_t addr, uint16_t size);
+
     public:
     SimpleMemory();
     virtual void load(const uint8_t *program, const uint16_t size);
     virtual bool read(uint16_t addr, uint8_t *dest, uint8_t size);
     virtual bool write(uint16_t addr, uint8_t *src, uint8_t size);
     virtual void reset() {};
+
+    // Only pages changed since snapshot was last saved from (or restored to)
+    // this memory are copied.
+    virtual bool save(MemorySnapshot &snapshot);
+    virtual bool restore(const MemorySnapshot &snapshot, uint32_t &changed);
 };
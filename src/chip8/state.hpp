@@ -45,4 +45,36 @@ struct EmuState {
 
     // Set to true if the emulator is halted waiting for a keypress.
     bool AwaitingKey = false;
+
+    // Set to true if the emulator is halted until the next tick, after
+    // drawing with the display wait quirk enabled.
+    bool AwaitingDisplay = false;
+
+    // Idle loop detection (see Chip8::checkIdle).
+    // The short backward jump that was last taken, if the loop it closes
+    // only reads the delay timer and keys. 0 if there's no such jump.
+    uint16_t IdleJump = 0;
+
+    // Set if a register changed since IdleJump was taken.
+    bool IdleChanged = false;
+
+    // Set to true if the emulator is halted until the next tick, because the
+    // program is spinning in a loop that can't exit before then.
+    bool Idle = false;
+
+    // State of the random number generator used by 0xCXnn (see nextRandom).
+    // Keeping it here means a run can be reproduced from its seed and
+    // inputs, and a snapshot picks up where it left off. Never 0.
+    uint32_t Random = 1;
 };
+
+// Advance the random number generator in state, and return the next byte.
+// This is xorshift32: cheap, and plenty random enough for games.
+inline uint8_t nextRandom(EmuState &state) {
+    uint32_t x = state.Random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state.Random = x;
+    return x >> 24;
+}
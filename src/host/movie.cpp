@@ -0,0 +1,158 @@
+#include "movie.hpp"
+
+#include <string.h>
+
+static const char MAGIC[4] = {'C', '8', 'M', 'V'};
+
+static void put16(FILE *file, uint16_t value) {
+    fputc(value, file);
+    fputc(value >> 8, file);
+}
+
+static void put32(FILE *file, uint32_t value) {
+    put16(file, value);
+    put16(file, value >> 16);
+}
+
+static void putVarint(FILE *file, uint32_t value) {
+    while(value >= 0x80) {
+        fputc(value | 0x80, file);
+        value >>= 7;
+    }
+    fputc(value, file);
+}
+
+static bool get16(FILE *file, uint16_t &value) {
+    int lo = fgetc(file);
+    int hi = fgetc(file);
+    if(hi == EOF) return false;
+    value = lo | hi << 8;
+    return true;
+}
+
+static bool get32(FILE *file, uint32_t &value) {
+    uint16_t lo, hi;
+    if(!get16(file, lo) || !get16(file, hi)) return false;
+    value = lo | (uint32_t)hi << 16;
+    return true;
+}
+
+static bool getVarint(FILE *file, uint32_t &value) {
+    value = 0;
+    for(uint8_t shift = 0; shift < 32; shift += 7) {
+        int byte = fgetc(file);
+        if(byte == EOF) return false;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+// FNV-1a.
+uint32_t hashProgram(const uint8_t *code, uint16_t size) {
+    uint32_t hash = 0x811C9DC5;
+    while(size--) hash = (hash ^ *code++) * 0x01000193;
+    return hash;
+}
+
+MovieWriter::MovieWriter() : mFile(NULL) {}
+
+MovieWriter::~MovieWriter() {
+    close();
+}
+
+void MovieWriter::writeHeader() {
+    fwrite(MAGIC, 1, sizeof(MAGIC), mFile);
+    fputc(MOVIE_VERSION, mFile);
+    fwrite(mHeader.Program, 1, MOVIE_NAME_SIZE, mFile);
+    put32(mFile, mHeader.ProgramHash);
+    fputc(mHeader.Quirks, mFile);
+    put16(mFile, mHeader.CyclesPerFrame);
+    put32(mFile, mHeader.Seed);
+    put32(mFile, mHeader.Frames);
+}
+
+void MovieWriter::writeRun() {
+    if(mRun == 0) return;
+    put16(mFile, mButtons);
+    putVarint(mFile, mRun);
+    mRun = 0;
+}
+
+bool MovieWriter::open(const char *path, const MovieHeader &header) {
+    close();
+    mFile = fopen(path, "wb");
+    if(!mFile) return false;
+    mHeader = header;
+    mHeader.Program[MOVIE_NAME_SIZE - 1] = 0;
+    mHeader.Frames = 0;
+    mRun = 0;
+    writeHeader();
+    return true;
+}
+
+void MovieWriter::frame(uint16_t buttons) {
+    if(!mFile) return;
+    if(mRun > 0 && buttons != mButtons) writeRun();
+    mButtons = buttons;
+    mRun++;
+    mHeader.Frames++;
+}
+
+// The frame count isn't known until the end, so the header is written again.
+bool MovieWriter::close() {
+    if(!mFile) return true;
+    writeRun();
+    rewind(mFile);
+    writeHeader();
+    bool ok = !ferror(mFile);
+    if(fclose(mFile) != 0) ok = false;
+    mFile = NULL;
+    return ok;
+}
+
+MovieReader::MovieReader() : mFile(NULL) {}
+
+MovieReader::~MovieReader() {
+    close();
+}
+
+bool MovieReader::open(const char *path) {
+    close();
+    mFile = fopen(path, "rb");
+    if(!mFile) return false;
+    char magic[sizeof(MAGIC)];
+    bool ok = fread(magic, 1, sizeof(magic), mFile) == sizeof(magic)
+        && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0
+        && fgetc(mFile) == MOVIE_VERSION
+        && fread(mHeader.Program, 1, MOVIE_NAME_SIZE, mFile) == MOVIE_NAME_SIZE;
+    ok = ok && get32(mFile, mHeader.ProgramHash);
+    int quirks = ok ? fgetc(mFile) : EOF;
+    ok = ok && quirks != EOF
+        && get16(mFile, mHeader.CyclesPerFrame)
+        && get32(mFile, mHeader.Seed)
+        && get32(mFile, mHeader.Frames);
+    if(!ok) {
+        close();
+        return false;
+    }
+    mHeader.Quirks = quirks;
+    mHeader.Program[MOVIE_NAME_SIZE - 1] = 0;
+    mRun = 0;
+    return true;
+}
+
+bool MovieReader::next(uint16_t &buttons) {
+    if(!mFile) return false;
+    while(mRun == 0) {
+        if(!get16(mFile, mButtons) || !getVarint(mFile, mRun)) return false;
+    }
+    mRun--;
+    buttons = mButtons;
+    return true;
+}
+
+void MovieReader::close() {
+    if(mFile) fclose(mFile);
+    mFile = NULL;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define MOVIE_VERSION 1
+
+// Long enough for any name in programs.h.
+#define MOVIE_NAME_SIZE 32
+
+// Everything besides the inputs that's needed to replay a movie.
+struct MovieHeader {
+    // Name of the program, as in programs.h.
+    char Program[MOVIE_NAME_SIZE];
+
+    // hashProgram of the program's code. Names aren't unique (the CHIP-8
+    // and SCHIP versions of a program share one), and this also catches
+    // programs that changed since the recording.
+    uint32_t ProgramHash;
+
+    // The quirks the program ran with, as a mask of Quirk values.
+    uint8_t Quirks;
+
+    // Instructions run before each tick, as passed to Chip8::RunFrame.
+    uint16_t CyclesPerFrame;
+
+    // The seed passed to Chip8::SetSeed before the program started.
+    uint32_t Seed;
+
+    // The number of frames recorded.
+    uint32_t Frames;
+};
+
+// A hash of a program's code, to tell programs apart.
+uint32_t hashProgram(const uint8_t *code, uint16_t size);
+
+// An input movie: the button mask the emulator latched at each tick, from
+// the program's start. With the same program, seed, and instructions per
+// frame, replaying the buttons reproduces the run exactly.
+//
+// The file is the magic "C8MV", a version byte, then the header fields,
+// little-endian. The buttons follow as runs, since they rarely change: a
+// 16-bit mask, then a varint (7 bits per byte, low bits first) count of the
+// frames it was held for.
+class MovieWriter {
+    FILE *mFile;
+    MovieHeader mHeader;
+
+    // The run being recorded.
+    uint16_t mButtons;
+    uint32_t mRun;
+
+    void writeHeader();
+    void writeRun();
+
+    public:
+        MovieWriter();
+        ~MovieWriter();
+
+        // Start recording to path. header.Frames is ignored. Returns false if
+        // the file can't be created.
+        bool open(const char *path, const MovieHeader &header);
+
+        bool isOpen() { return mFile != NULL; }
+
+        // Record the buttons latched by a tick.
+        void frame(uint16_t buttons);
+
+        // Finish the file. Returns false if anything couldn't be written.
+        bool close();
+};
+
+class MovieReader {
+    FILE *mFile;
+    MovieHeader mHeader;
+
+    // The run being replayed.
+    uint16_t mButtons;
+    uint32_t mRun;
+
+    public:
+        MovieReader();
+        ~MovieReader();
+
+        // Open the movie at path, and read its header. Returns false if it
+        // can't be read, or isn't a movie of this version.
+        bool open(const char *path);
+
+        const MovieHeader& header() { return mHeader; }
+
+        // Get the buttons for the next frame. Returns false at the end of the
+        // movie.
+        bool next(uint16_t &buttons);
+
+        void close();
+};
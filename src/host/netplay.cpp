@@ -0,0 +1,198 @@
+#include "netplay.hpp"
+
+#include <string.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <random>
+
+static const char MAGIC[4] = {'C', '8', 'N', 'P'};
+
+// A packet is the magic, then, little-endian: the program hash, the sender's
+// nonce and keys, the number of the receiver's frames the sender has
+// confirmed, the first frame of input sent, a count, and that many 16-bit
+// inputs.
+#define HEADER_SIZE 23
+#define PACKET_SIZE (HEADER_SIZE + NET_INPUT_WINDOW * 2)
+
+static uint8_t* put16(uint8_t *out, uint16_t value) {
+    *out++ = value;
+    *out++ = value >> 8;
+    return out;
+}
+
+static uint8_t* put32(uint8_t *out, uint32_t value) {
+    out = put16(out, value);
+    return put16(out, value >> 16);
+}
+
+static const uint8_t* get16(const uint8_t *in, uint16_t &value) {
+    value = in[0] | in[1] << 8;
+    return in + 2;
+}
+
+static const uint8_t* get32(const uint8_t *in, uint32_t &value) {
+    uint16_t lo, hi;
+    in = get16(in, lo);
+    in = get16(in, hi);
+    value = lo | (uint32_t)hi << 16;
+    return in;
+}
+
+NetSession::NetSession() : mSocket(-1) {}
+
+NetSession::~NetSession() {
+    if(mSocket >= 0) close(mSocket);
+}
+
+bool NetSession::open(uint16_t localPort, const char *peerHost, uint16_t peerPort, uint16_t keys, uint32_t programHash) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo *peer;
+    if(getaddrinfo(peerHost, NULL, &hints, &peer) != 0) return false;
+    memcpy(&mPeer, peer->ai_addr, sizeof(mPeer));
+    mPeer.sin_port = htons(peerPort);
+    freeaddrinfo(peer);
+
+    mSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    if(mSocket < 0) return false;
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(localPort);
+    if(bind(mSocket, (sockaddr*)&local, sizeof(local)) != 0
+        || fcntl(mSocket, F_SETFL, O_NONBLOCK) != 0) {
+        close(mSocket);
+        mSocket = -1;
+        return false;
+    }
+
+    mKeys = keys;
+    mPeerKeys = 0;
+    mNonce = std::random_device()();
+    mPeerNonce = 0;
+    mConnected = false;
+    mWrongProgram = false;
+    mProgramHash = programHash;
+    mLocalFrames = 0;
+    mAcked = 0;
+    mRemoteFrames = 0;
+    mUsedFrames = 0;
+    mMispredicted = NET_NONE;
+    for(uint8_t i = 0; i < NET_RING; i++) mRemoteFrame[i] = NET_NONE;
+    return true;
+}
+
+void NetSession::poll() {
+    uint8_t packet[PACKET_SIZE];
+    while(true) {
+        ssize_t size = recv(mSocket, packet, sizeof(packet), 0);
+        if(size < 0) return;
+        receive(packet, size);
+    }
+}
+
+void NetSession::receive(const uint8_t *packet, int size) {
+    if(size < HEADER_SIZE || memcmp(packet, MAGIC, sizeof(MAGIC)) != 0) return;
+    uint32_t hash, nonce, ack, frame;
+    uint16_t keys;
+    const uint8_t *in = packet + sizeof(MAGIC);
+    in = get32(in, hash);
+    in = get32(in, nonce);
+    in = get16(in, keys);
+    in = get32(in, ack);
+    in = get32(in, frame);
+    uint8_t count = *in++;
+    if(count > NET_INPUT_WINDOW || size != HEADER_SIZE + count * 2) return;
+    if(hash != mProgramHash) {
+        mWrongProgram = true;
+        return;
+    }
+    if(!mConnected) {
+        mPeerNonce = nonce;
+        mPeerKeys = keys;
+        mConnected = true;
+    } else if(nonce != mPeerNonce) {
+        // A stale packet from an earlier session.
+        return;
+    }
+
+    if(ack > mAcked && ack <= mLocalFrames) mAcked = ack;
+
+    // Keep what's new, as far ahead as can be kept without overwriting the
+    // confirmed inputs a rollback might still need.
+    for(uint8_t i = 0; i < count; i++, frame++) {
+        uint16_t input;
+        in = get16(in, input);
+        if(frame < mRemoteFrames) continue;
+        if(frame >= mRemoteFrames + NET_RING / 2) break;
+        mRemote[frame & (NET_RING - 1)] = input;
+        mRemoteFrame[frame & (NET_RING - 1)] = frame;
+    }
+
+    // Confirm every frame we now have all the inputs up to, checking them
+    // against what was predicted.
+    while(true) {
+        uint8_t slot = mRemoteFrames & (NET_RING - 1);
+        if(mRemoteFrame[slot] != mRemoteFrames) break;
+        if(mRemoteFrames < mUsedFrames && mUsed[slot] != mRemote[slot] && mRemoteFrames < mMispredicted) {
+            mMispredicted = mRemoteFrames;
+        }
+        mRemoteFrames++;
+    }
+}
+
+void NetSession::send() {
+    uint8_t packet[PACKET_SIZE];
+    uint32_t count = mLocalFrames - mAcked;
+    if(count > NET_INPUT_WINDOW) count = NET_INPUT_WINDOW;
+    memcpy(packet, MAGIC, sizeof(MAGIC));
+    uint8_t *out = packet + sizeof(MAGIC);
+    out = put32(out, mProgramHash);
+    out = put32(out, mNonce);
+    out = put16(out, mKeys);
+    out = put32(out, mRemoteFrames);
+    out = put32(out, mAcked);
+    *out++ = count;
+    for(uint32_t frame = mAcked; frame < mAcked + count; frame++) {
+        out = put16(out, mLocal[frame & (NET_RING - 1)]);
+    }
+    // Lost packets are made up for by the next one, so errors are ignored.
+    sendto(mSocket, packet, out - packet, 0, (sockaddr*)&mPeer, sizeof(mPeer));
+}
+
+void NetSession::addLocalInput(uint16_t held) {
+    mLocal[mLocalFrames & (NET_RING - 1)] = held & mKeys;
+    mLocalFrames++;
+}
+
+// Unacknowledged inputs must all fit in a packet, and in the ring.
+bool NetSession::canAdvance() {
+    return mLocalFrames - mRemoteFrames < NET_MAX_ROLLBACK
+        && mLocalFrames - mAcked < NET_INPUT_WINDOW;
+}
+
+uint16_t NetSession::input(uint32_t frame) {
+    uint8_t slot = frame & (NET_RING - 1);
+    uint16_t remote;
+    if(frame < mRemoteFrames) {
+        remote = mRemote[slot];
+    } else if(mRemoteFrames > 0) {
+        remote = mRemote[(mRemoteFrames - 1) & (NET_RING - 1)];
+    } else {
+        remote = 0;
+    }
+    mUsed[slot] = remote;
+    if(frame >= mUsedFrames) mUsedFrames = frame + 1;
+    uint16_t local = frame < mLocalFrames ? mLocal[slot] : 0;
+    return local | (remote & mPeerKeys);
+}
+
+bool NetSession::mispredicted(uint32_t &frame) {
+    if(mMispredicted == NET_NONE) return false;
+    frame = mMispredicted;
+    mMispredicted = NET_NONE;
+    return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <stdint.h>
+#include <netinet/in.h>
+
+// The furthest ahead of the peer's confirmed inputs a session runs. Any
+// further, and it waits for the peer, since every frame past the peer's
+// confirmed inputs might need simulating again.
+#define NET_MAX_ROLLBACK 8
+
+// Frames of inputs kept. Must be a power of 2, and more than twice
+// NET_MAX_ROLLBACK.
+#define NET_RING 32
+
+// The most local inputs sent in one packet.
+#define NET_INPUT_WINDOW 16
+
+#define NET_NONE 0xFFFFFFFF
+
+// The inputs of a two player netplay session.
+//
+// Each peer owns some of the 16 keys, and runs the same program from the same
+// seed, sending the keys it holds each frame to the other over UDP. A peer
+// doesn't wait for the other's inputs: it predicts they haven't changed, and
+// carries on. When the real inputs arrive, and they differ from the
+// prediction, the frames since then have to be rolled back (restored from a
+// snapshot) and simulated again. That's left to the caller (see
+// Chip8Runner::netFrame); this only keeps track of the inputs.
+//
+// Packets carry every local input the peer hasn't acknowledged yet, so lost
+// packets are made up for by the next one. Until the peers have heard from
+// each other, they only exchange packets, to agree on the seed.
+class NetSession {
+    int mSocket;
+
+    sockaddr_in mPeer;
+
+    // The keys this peer owns, and the ones the other peer owns.
+    uint16_t mKeys;
+    uint16_t mPeerKeys;
+
+    // A random number from each peer. Together they make the seed.
+    uint32_t mNonce;
+    uint32_t mPeerNonce;
+    bool mConnected;
+
+    // Both peers must be running the same program.
+    uint32_t mProgramHash;
+
+    // Local inputs, by frame, and the number of frames with local inputs.
+    uint16_t mLocal[NET_RING];
+    uint32_t mLocalFrames;
+
+    // Frames of local input the peer has confirmed.
+    uint32_t mAcked;
+
+    // Remote inputs, by frame, and the frame each slot holds. Inputs can
+    // arrive out of order, so frames past mRemoteFrames may be here already.
+    uint16_t mRemote[NET_RING];
+    uint32_t mRemoteFrame[NET_RING];
+
+    // The number of frames of remote input confirmed, from frame 0.
+    uint32_t mRemoteFrames;
+
+    // The remote inputs that were used (predicted or not) for each frame
+    // simulated, and the number of frames simulated.
+    uint16_t mUsed[NET_RING];
+    uint32_t mUsedFrames;
+
+    // The first frame that was simulated with the wrong remote inputs, or
+    // NET_NONE if there isn't one.
+    uint32_t mMispredicted;
+
+    // Set when a packet arrives from a peer running another program.
+    bool mWrongProgram;
+
+    void receive(const uint8_t *packet, int size);
+
+    public:
+        NetSession();
+        ~NetSession();
+
+        // Start a session on localPort, with the peer at peerHost:peerPort,
+        // owning keys (a mask, 0-F little-endian). Returns false if the
+        // socket can't be set up, or the peer's address can't be found.
+        bool open(uint16_t localPort, const char *peerHost, uint16_t peerPort, uint16_t keys, uint32_t programHash);
+
+        // Read all the packets that have arrived.
+        void poll();
+
+        // Send the local inputs the peer hasn't acknowledged.
+        void send();
+
+        // True once the peers have heard from each other, so the game can
+        // start, using seed.
+        bool connected() { return mConnected; }
+        uint32_t seed() { return mNonce ^ mPeerNonce; }
+
+        // True if the peer has been heard from, but is running a different
+        // program, so the session can't start.
+        bool wrongProgram() { return mWrongProgram; }
+
+        uint16_t keys() { return mKeys; }
+        uint16_t peerKeys() { return mPeerKeys; }
+
+        // Set the local keys held for the next frame. held is masked to the
+        // keys this peer owns.
+        void addLocalInput(uint16_t held);
+        uint32_t localFrames() { return mLocalFrames; }
+
+        // The number of frames of the peer's inputs that have been
+        // confirmed.
+        uint32_t remoteFrames() { return mRemoteFrames; }
+
+        // False if the next frame would be more than NET_MAX_ROLLBACK frames
+        // past the peer's confirmed inputs, or the peer has fallen too far
+        // behind in acknowledging ours, so the caller should wait.
+        bool canAdvance();
+
+        // The keys held in frame, local and remote, predicting the remote
+        // inputs if they aren't confirmed yet. The prediction is remembered,
+        // to check against the real inputs. Frames must be asked for in
+        // order, apart from going back to the result of mispredicted.
+        uint16_t input(uint32_t frame);
+
+        // If frames have been simulated with wrong predictions, returns true
+        // and sets frame to the first of them. The caller should go back to
+        // that frame, and simulate forward from there again.
+        bool mispredicted(uint32_t &frame);
+};
@@ -0,0 +1,322 @@
+#include "recompiler.hpp"
+#include "../chip8/chip8-reg.hpp"
+
+#include <stddef.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+#define RECOMPILER_NATIVE 1
+#include <sys/mman.h>
+#else
+#define RECOMPILER_NATIVE 0
+#endif
+
+// The most bytes a single block can take up in the arena (the worst case is
+// about 32 bytes per instruction, plus the epilogue).
+#define MAX_BLOCK_BYTES 2048
+
+// Registers, as used in the reg field of a ModRM byte.
+#define REG_AL 0
+#define REG_CL 1
+
+// Offsets of the EmuState fields that translated code touches.
+#define OFF_V(r) (offsetof(EmuState, V) + (r))
+#define OFF_VF OFF_V(0xF)
+#define OFF_PC offsetof(EmuState, PC)
+#define OFF_INST offsetof(EmuState, Instruction)
+#define OFF_NEXTPC offsetof(EmuState, NextPC)
+#define OFF_INDEX offsetof(EmuState, Index)
+#define OFF_DT offsetof(EmuState, DelayTimer)
+
+// Appends x86-64 machine code to a buffer. The EmuState pointer is always in
+// rdi (the first argument in the SysV calling convention), so every memory
+// operand is [rdi + disp32].
+class Emitter {
+    uint8_t *mCode;
+    uint32_t mUsed;
+
+    public:
+        Emitter(uint8_t *code) : mCode(code), mUsed(0) {}
+
+        uint32_t used() { return mUsed; }
+
+        void byte(uint8_t b) { mCode[mUsed++] = b; }
+        void word(uint16_t w) { byte(w); byte(w >> 8); }
+        void dword(uint32_t d) { word(d); word(d >> 16); }
+
+        // A ModRM byte for [rdi + disp32] with the provided reg field,
+        // followed by the displacement.
+        void mem(uint8_t reg, uint32_t disp) { byte(0x87 | (reg << 3)); dword(disp); }
+
+        // mov byte [rdi+disp], imm8
+        void movMemImm8(uint32_t disp, uint8_t imm) { byte(0xC6); mem(0, disp); byte(imm); }
+
+        // mov word [rdi+disp], imm16
+        void movMemImm16(uint32_t disp, uint16_t imm) { byte(0x66); byte(0xC7); mem(0, disp); word(imm); }
+
+        // add byte [rdi+disp], imm8
+        void addMemImm8(uint32_t disp, uint8_t imm) { byte(0x80); mem(0, disp); byte(imm); }
+
+        // cmp byte [rdi+disp], imm8
+        void cmpMemImm8(uint32_t disp, uint8_t imm) { byte(0x80); mem(7, disp); byte(imm); }
+
+        // <op> r8, byte [rdi+disp], for mov (0x8A), add (0x02), sub (0x2A), cmp (0x3A)
+        void opRegMem8(uint8_t op, uint8_t reg, uint32_t disp) { byte(op); mem(reg, disp); }
+
+        // <op> byte [rdi+disp], r8, for mov (0x88), or (0x08), and (0x20), xor (0x30)
+        void opMemReg8(uint8_t op, uint8_t reg, uint32_t disp) { byte(op); mem(reg, disp); }
+
+        // movzx eax, byte [rdi+disp]
+        void movzxEaxMem8(uint32_t disp) { byte(0x0F); byte(0xB6); mem(REG_AL, disp); }
+
+        // mov word [rdi+disp], ax
+        void movMemAx(uint32_t disp) { byte(0x66); byte(0x89); mem(REG_AL, disp); }
+
+        // add word [rdi+disp], ax
+        void addMemAx(uint32_t disp) { byte(0x66); byte(0x01); mem(REG_AL, disp); }
+
+        // lea eax, [rax+rax*4]
+        void timesFiveEax() { byte(0x8D); byte(0x04); byte(0x80); }
+
+        // setc cl (cf=true), or setnc cl (cf=false)
+        void setCarryCl(bool cf) { byte(0x0F); byte(cf ? 0x92 : 0x93); byte(0xC1); }
+
+        // Skip a following movMemImm16 if the flags say so. je (0x74) or jne (0x75).
+        void jccOverMovImm16(uint8_t op) { byte(op); byte(9); }
+
+        void ret() { byte(0xC3); }
+};
+
+// Emit code that sets NextPC to pc+2, or to pc+4 if the jcc doesn't jump.
+// This must directly follow the comparison; mov doesn't affect flags.
+static void emitSkip(Emitter &e, uint16_t pc, uint8_t jcc) {
+    e.movMemImm16(OFF_NEXTPC, pc + 2);
+    e.jccOverMovImm16(jcc);
+    e.movMemImm16(OFF_NEXTPC, pc + 4);
+}
+
+// Emit code for an ALU instruction that stores its result in VX, and a
+// flag in VF. The flag is written last, as in the interpreter.
+//   mov al, [VX or VY]; add/sub al, [VY or VX]; setc/setnc cl; mov [VX], al; mov [VF], cl
+static void emitAluFlag(Emitter &e, uint8_t first, uint8_t op, uint8_t second, bool cf, uint8_t vx) {
+    e.opRegMem8(0x8A, REG_AL, OFF_V(first));
+    e.opRegMem8(op, REG_AL, OFF_V(second));
+    e.setCarryCl(cf);
+    e.opMemReg8(0x88, REG_AL, OFF_V(vx));
+    e.opMemReg8(0x88, REG_CL, OFF_VF);
+}
+
+// Emit code for an ALU instruction that combines VY into VX, clearing VF
+// afterwards if vfReset is set.
+//   mov al, [VY]; <op> [VX], al; (mov byte [VF], 0)
+static void emitAluLogic(Emitter &e, uint8_t op, uint8_t vx, uint8_t vy, bool vfReset) {
+    e.opRegMem8(0x8A, REG_AL, OFF_V(vy));
+    e.opMemReg8(op, REG_AL, OFF_V(vx));
+    if(vfReset) e.movMemImm8(OFF_VF, 0);
+}
+
+// 0x8XYx - ALU Group. Shifts depend on the configured quirks, so they are
+// left to the interpreter.
+static bool emitALU(Emitter &e, uint16_t inst, bool vfReset) {
+    uint8_t vx = x(inst);
+    uint8_t vy = y(inst);
+    switch(inst & 0xF) {
+        case 0x0: e.opRegMem8(0x8A, REG_AL, OFF_V(vy)); e.opMemReg8(0x88, REG_AL, OFF_V(vx)); return true;
+        case 0x1: emitAluLogic(e, 0x08, vx, vy, vfReset); return true;
+        case 0x2: emitAluLogic(e, 0x20, vx, vy, vfReset); return true;
+        case 0x3: emitAluLogic(e, 0x30, vx, vy, vfReset); return true;
+        // VF = carry.
+        case 0x4: emitAluFlag(e, vx, 0x02, vy, true, vx); return true;
+        // VF = 1 if no borrow.
+        case 0x5: emitAluFlag(e, vx, 0x2A, vy, false, vx); return true;
+        case 0x7: emitAluFlag(e, vy, 0x2A, vx, false, vx); return true;
+    }
+    return false;
+}
+
+// 0xFnnn - Load group. Only the ones that just touch registers.
+static bool emitLoad(Emitter &e, uint16_t inst) {
+    uint8_t vx = x(inst);
+    switch(imm8(inst)) {
+        // VX = DT
+        case 0x07:
+            e.opRegMem8(0x8A, REG_AL, OFF_DT);
+            e.opMemReg8(0x88, REG_AL, OFF_V(vx));
+            return true;
+        // DT = VX
+        case 0x15:
+            e.movzxEaxMem8(OFF_V(vx));
+            e.movMemAx(OFF_DT);
+            return true;
+        // I += VX
+        case 0x1E:
+            e.movzxEaxMem8(OFF_V(vx));
+            e.addMemAx(OFF_INDEX);
+            return true;
+        // I = 5 * VX
+        case 0x29:
+            e.movzxEaxMem8(OFF_V(vx));
+            e.timesFiveEax();
+            e.movMemAx(OFF_INDEX);
+            return true;
+    }
+    return false;
+}
+
+// Emit code for inst at pc. Returns false if the instruction can't be
+// translated, in which case nothing was emitted. Sets ended if the
+// instruction updates NextPC itself, so the block has to end after it.
+static bool emitInstruction(Emitter &e, uint16_t pc, uint16_t inst, bool vfReset, bool &ended) {
+    uint8_t vx = x(inst);
+    uint8_t vy = y(inst);
+    switch(inst >> 12) {
+        case 0x1:
+            // The hi-res setup hack in Chip8::groupJump needs the interpreter.
+            if(pc == 0x200 && inst == 0x1260) return false;
+            e.movMemImm16(OFF_NEXTPC, imm12(inst));
+            ended = true;
+            return true;
+        case 0x3:
+            e.cmpMemImm8(OFF_V(vx), imm8(inst));
+            emitSkip(e, pc, 0x75);
+            ended = true;
+            return true;
+        case 0x4:
+            e.cmpMemImm8(OFF_V(vx), imm8(inst));
+            emitSkip(e, pc, 0x74);
+            ended = true;
+            return true;
+        case 0x5:
+        case 0x9:
+            if(imm4(inst) != 0) return false;
+            e.opRegMem8(0x8A, REG_AL, OFF_V(vx));
+            e.opRegMem8(0x3A, REG_AL, OFF_V(vy));
+            emitSkip(e, pc, (inst >> 12) == 0x5 ? 0x75 : 0x74);
+            ended = true;
+            return true;
+        case 0x6:
+            e.movMemImm8(OFF_V(vx), imm8(inst));
+            return true;
+        case 0x7:
+            e.addMemImm8(OFF_V(vx), imm8(inst));
+            return true;
+        case 0x8:
+            return emitALU(e, inst, vfReset);
+        case 0xA:
+            e.movMemImm16(OFF_INDEX, imm12(inst));
+            return true;
+        case 0xF:
+            return emitLoad(e, inst);
+    }
+    return false;
+}
+
+// Installed for addresses whose first instruction can't be translated, so we
+// don't try again every time.
+static void untranslated(EmuState *state) {}
+
+X86Recompiler::X86Recompiler(Memory &memory) :
+    mMemory(memory),
+    mArena(NULL),
+    mArenaUsed(0),
+    mVfReset(false) {
+#if RECOMPILER_NATIVE
+    void *arena = mmap(NULL, RECOMPILER_ARENA_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(arena != MAP_FAILED) mArena = (uint8_t*)arena;
+#endif
+    reset();
+}
+
+X86Recompiler::~X86Recompiler() {
+#if RECOMPILER_NATIVE
+    if(mArena) munmap(mArena, RECOMPILER_ARENA_SIZE);
+#endif
+}
+
+void X86Recompiler::reset() {
+    memset(mBlocks, 0, sizeof(mBlocks));
+    memset(mBlockCounts, 0, sizeof(mBlockCounts));
+    mArenaUsed = 0;
+}
+
+void X86Recompiler::configure(Config config) {
+    mVfReset = config.VfResetQuirk;
+    reset();
+}
+
+void X86Recompiler::translate(uint16_t addr) {
+    mBlocks[addr] = untranslated;
+    mBlockCounts[addr] = 0;
+    if(!mArena) return;
+
+    // Start over if this block might not fit.
+    if(mArenaUsed + MAX_BLOCK_BYTES > RECOMPILER_ARENA_SIZE) {
+        reset();
+        mBlocks[addr] = untranslated;
+    }
+
+    Emitter e(mArena + mArenaUsed);
+    uint16_t pc = addr;
+    uint16_t inst = 0;
+    uint16_t lastInst = 0;
+    uint8_t count = 0;
+    bool ended = false;
+    while(count < RECOMPILER_MAX_BLOCK && !ended) {
+        if(!mMemory.read(pc, (uint8_t*)&inst, 2)) break;
+        inst = (inst >> 8) | (inst << 8);
+        if(!emitInstruction(e, pc, inst, mVfReset, ended)) break;
+        lastInst = inst;
+        count++;
+        pc += 2;
+    }
+    if(count == 0) return;
+
+    // Leave the state as if the interpreter had just executed the last
+    // instruction of the block.
+    if(!ended) e.movMemImm16(OFF_NEXTPC, pc);
+    e.movMemImm16(OFF_PC, pc - 2);
+    e.movMemImm16(OFF_INST, lastInst);
+    e.ret();
+
+    mBlocks[addr] = (BlockFn)(void*)(mArena + mArenaUsed);
+    mBlockCounts[addr] = count;
+    mArenaUsed += e.used();
+}
+
+// A block starting at start covers two bytes per instruction (or the one
+// instruction we couldn't translate).
+void X86Recompiler::invalidate(uint16_t addr, uint8_t size) {
+    uint16_t first = addr > RECOMPILER_MAX_BLOCK * 2 ? addr - RECOMPILER_MAX_BLOCK * 2 : 0;
+    uint16_t end = addr + size;
+    if(end > RECOMPILER_TABLE_SIZE) end = RECOMPILER_TABLE_SIZE;
+    for(uint16_t start = first; start < end; start++) {
+        if(!mBlocks[start]) continue;
+        uint8_t count = mBlockCounts[start] > 0 ? mBlockCounts[start] : 1;
+        if(start + count * 2 > addr) mBlocks[start] = NULL;
+    }
+}
+
+bool X86Recompiler::read(uint16_t addr, uint8_t *dest, uint8_t size) {
+    return mMemory.read(addr, dest, size);
+}
+
+bool X86Recompiler::write(uint16_t addr, uint8_t *src, uint8_t size) {
+    invalidate(addr, size);
+    return mMemory.write(addr, src, size);
+}
+
+bool X86Recompiler::save(MemorySnapshot &snapshot) {
+    return mMemory.save(snapshot);
+}
+
+bool X86Recompiler::restore(const MemorySnapshot &snapshot, uint32_t &changed) {
+    if(!mMemory.restore(snapshot, changed)) return false;
+    for(uint8_t page = 0; page < SNAPSHOT_PAGES; page++) {
+        if(!(changed & ((uint32_t)1 << page))) continue;
+        uint16_t addr = page * SNAPSHOT_PAGE_SIZE;
+        invalidate(addr, SNAPSHOT_PAGE_SIZE / 2);
+        invalidate(addr + SNAPSHOT_PAGE_SIZE / 2, SNAPSHOT_PAGE_SIZE / 2);
+    }
+    return true;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "../chip8/chip8.hpp"
+#include "../chip8/memory.hpp"
+#include "../chip8/state.hpp"
+
+#include <stdint.h>
+
+// The recompiler only keeps track of blocks starting in the 12-bit address
+// space. Anything above that is always interpreted.
+#define RECOMPILER_TABLE_SIZE 0x1000
+
+// The longest run of instructions that will be translated into one block.
+#define RECOMPILER_MAX_BLOCK 32
+
+// Size of the executable arena that translated blocks are placed in. When it
+// fills up, every block is thrown away and translation starts over.
+#define RECOMPILER_ARENA_SIZE (256*1024)
+
+// A basic-block translator that compiles runs of simple Chip8 instructions
+// (register loads and arithmetic, index updates, delay timer access, skips and
+// jumps) into native x86-64 code operating directly on the EmuState.
+//
+// Blocks end at the first instruction that can't be translated. That includes
+// anything which needs the Render (DXYN, CLS, CXNN...), memory (FX55, FX65...),
+// FX0A, calls and returns. Those are executed by the regular Chip8::Step
+// interpreter, so everything the interpreter can run still works. Translated
+// blocks don't call the Tracer.
+//
+// Block lookup wraps the platform memory: pass the recompiler to the Chip8
+// constructor as its Memory, and any write that touches a translated block
+// drops it, so self-modifying programs keep working.
+//
+// On platforms other than x86-64 nothing is translated, and Run just steps
+// the interpreter.
+class X86Recompiler : public Memory {
+    typedef void (*BlockFn)(EmuState *state);
+
+    // The memory being wrapped.
+    Memory &mMemory;
+
+    // Executable memory that blocks are emitted into.
+    uint8_t *mArena;
+    uint32_t mArenaUsed;
+
+    // Translated block for each start address, or NULL if we haven't tried
+    // translating there yet.
+    BlockFn mBlocks[RECOMPILER_TABLE_SIZE];
+
+    // The number of instructions each block executes. A translated block with
+    // a count of 0 means the first instruction couldn't be translated, and the
+    // interpreter should run it.
+    uint8_t mBlockCounts[RECOMPILER_TABLE_SIZE];
+
+    // Whether translated logic ops should clear VF (Config::VfResetQuirk).
+    bool mVfReset;
+
+    // Translate the block starting at addr, and record it in the tables.
+    void translate(uint16_t addr);
+
+    // Drop any blocks that cover the size bytes starting at addr.
+    void invalidate(uint16_t addr, uint8_t size);
+
+    public:
+        X86Recompiler(Memory &memory);
+        ~X86Recompiler();
+
+        // Throw away all translated blocks. Call this after loading a new
+        // program directly into the wrapped memory.
+        void reset();
+
+        // Translate for the quirks in config, which should match the
+        // emulator's. This also throws away all translated blocks.
+        void configure(Config config);
+
+        // Run up to budget instructions, using translated blocks where
+        // possible, and the interpreter otherwise. Stops early if the
+        // emulator reports an error or starts waiting for a key. The number of
+        // instructions executed is added to executed.
+        template<typename EmuT>
+        ErrorType Run(EmuT &emu, uint16_t budget, uint32_t &executed);
+
+        virtual bool read(uint16_t addr, uint8_t *dest, uint8_t size);
+        virtual bool write(uint16_t addr, uint8_t *src, uint8_t size);
+
+        // Snapshots are of the wrapped memory. Restoring one drops the
+        // blocks in the pages it changed.
+        virtual bool save(MemorySnapshot &snapshot);
+        virtual bool restore(const MemorySnapshot &snapshot, uint32_t &changed);
+};
+
+// Run is a template so that it works with whichever Chip8 instantiation the
+// platform uses.
+template<typename EmuT>
+ErrorType X86Recompiler::Run(EmuT &emu, uint16_t budget, uint32_t &executed) {
+    EmuState &state = emu.MutableState();
+    while(budget > 0) {
+        // Let the interpreter report halts, and don't spin while waiting for
+        // a key, the display, or the next tick.
+        if(!state.Running || state.AwaitingKey || state.AwaitingDisplay || state.Idle) return emu.Step();
+
+        uint16_t pc = state.NextPC;
+        if(pc < RECOMPILER_TABLE_SIZE) {
+            if(!mBlocks[pc]) translate(pc);
+            uint8_t count = mBlockCounts[pc];
+            if(count > 0 && count <= budget) {
+                mBlocks[pc](&state);
+                // Blocks jump without the interpreter's idle loop tracking.
+                state.IdleJump = 0;
+                budget -= count;
+                executed += count;
+                continue;
+            }
+        }
+
+        ErrorType error = emu.Step();
+        budget--;
+        executed++;
+        if(error != NO_ERROR) return error;
+    }
+    return NO_ERROR;
+}
@@ -0,0 +1,133 @@
+#include "rewind.hpp"
+
+#include <string.h>
+
+// Varints are 7 bits per byte, least significant first, with the top bit set
+// on every byte but the last.
+static uint8_t* putVarint(uint8_t *out, uint32_t value) {
+    while(value >= 0x80) {
+        *out++ = value | 0x80;
+        value >>= 7;
+    }
+    *out++ = value;
+    return out;
+}
+
+static const uint8_t* getVarint(const uint8_t *in, uint32_t &value) {
+    value = 0;
+    for(uint8_t shift = 0; ; shift += 7) {
+        uint8_t byte = *in++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)) return in;
+    }
+}
+
+// The number of bytes from i that match, checking 8 at a time while we can.
+static uint32_t matching(const uint8_t *a, const uint8_t *b, uint32_t i, uint32_t size) {
+    uint32_t start = i;
+    while(i + 8 <= size) {
+        uint64_t wa, wb;
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+        if(wa != wb) break;
+        i += 8;
+    }
+    while(i < size && a[i] == b[i]) i++;
+    return i - start;
+}
+
+RewindBuffer::RewindBuffer(uint8_t *arena, uint32_t arenaSize, RewindEntry *entries, uint32_t entryCount) :
+    mArena(arena), mArenaSize(arenaSize), mEntries(entries), mEntryCount(entryCount) {
+    reset();
+}
+
+void RewindBuffer::reset() {
+    mFirst = 0;
+    mCount = 0;
+    mHead = 0;
+    // The first delta is against this, but it's never undone, so any state
+    // will do.
+    mLast = SaveState();
+}
+
+void RewindBuffer::dropOldest() {
+    mFirst = (mFirst + 1) % mEntryCount;
+    mCount--;
+}
+
+// The entries run from the oldest to mHead, possibly wrapping around the end of
+// the arena. When an entry doesn't fit before the end, the rest of the arena
+// is left unused, and it goes at the start instead.
+void RewindBuffer::makeRoom() {
+    if(mCount == mEntryCount) dropOldest();
+    while(mCount > 0) {
+        uint32_t tail = mEntries[mFirst].Offset;
+        if(mHead > tail) {
+            if(mArenaSize - mHead >= MAX_ENCODED) return;
+            mHead = 0;
+            continue;
+        }
+        if(mHead < tail && tail - mHead >= MAX_ENCODED) return;
+        dropOldest();
+    }
+    mHead = 0;
+}
+
+void RewindBuffer::push(const SaveState &state) {
+    makeRoom();
+    const uint8_t *cur = (const uint8_t*)&state;
+    uint8_t *last = (uint8_t*)&mLast;
+    uint8_t *out = mArena + mHead;
+    uint32_t i = 0;
+    while(i < sizeof(SaveState)) {
+        uint32_t skip = matching(cur, last, i, sizeof(SaveState));
+        i += skip;
+        if(i == sizeof(SaveState)) break;
+        // Carry on through short runs of matching bytes, which cost less as
+        // literals than as a new pair.
+        uint32_t start = i;
+        while(i < sizeof(SaveState)) {
+            if(cur[i] != last[i]) {
+                i++;
+            } else if(i + 2 < sizeof(SaveState) && (cur[i + 1] != last[i + 1] || cur[i + 2] != last[i + 2])) {
+                i++;
+            } else {
+                break;
+            }
+        }
+        out = putVarint(out, skip);
+        out = putVarint(out, i - start);
+        for(uint32_t j = start; j < i; j++) {
+            *out++ = cur[j] ^ last[j];
+            last[j] = cur[j];
+        }
+    }
+    RewindEntry &entry = mEntries[(mFirst + mCount) % mEntryCount];
+    entry.Offset = mHead;
+    entry.Size = out - (mArena + mHead);
+    mHead += entry.Size;
+    mCount++;
+}
+
+const SaveState* RewindBuffer::pop() {
+    // The oldest entry's delta is against a state that's already been
+    // dropped, so it can't be undone.
+    if(mCount < 2) return NULL;
+    const RewindEntry &entry = mEntries[(mFirst + mCount - 1) % mEntryCount];
+    const uint8_t *in = mArena + entry.Offset;
+    const uint8_t *end = in + entry.Size;
+    uint8_t *last = (uint8_t*)&mLast;
+    uint32_t i = 0;
+    while(in < end) {
+        uint32_t skip, count;
+        in = getVarint(in, skip);
+        in = getVarint(in, count);
+        i += skip;
+        for(uint32_t j = 0; j < count; j++) {
+            last[i++] ^= *in++;
+        }
+    }
+    mHead = entry.Offset;
+    mCount--;
+    return &mLast;
+}
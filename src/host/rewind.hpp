@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../chip8/savestate.hpp"
+
+#include <stdint.h>
+
+// Where an entry's encoded delta lives in the arena.
+struct RewindEntry {
+    uint32_t Offset;
+    uint32_t Size;
+};
+
+// A history of SaveStates, one per frame, that can be stepped back through.
+//
+// Each state is stored as the XOR of it and the state before it, which is
+// almost all zeros, since little changes in a frame. The XOR is run length
+// encoded as pairs of varints: the number of unchanged bytes to skip, and the
+// number of changed bytes that follow.
+//
+// Like DecodeCache, the storage is provided by the platform: an arena for the
+// encoded deltas, and an entry for each frame of history. Both are used as
+// rings, and when either is full the oldest frames are dropped, so memory use
+// is fixed up front, and nothing is allocated as frames are pushed.
+class RewindBuffer {
+    uint8_t *mArena;
+    uint32_t mArenaSize;
+
+    RewindEntry *mEntries;
+    uint32_t mEntryCount;
+
+    // Index of the oldest entry, and the number of entries held.
+    uint32_t mFirst;
+    uint32_t mCount;
+
+    // Where the next entry will be encoded.
+    uint32_t mHead;
+
+    // The newest state pushed, or the state that was stepped back to.
+    SaveState mLast;
+
+    // The most space a single encoded delta can take.
+    static const uint32_t MAX_ENCODED = sizeof(SaveState) * 3 / 2 + 16;
+
+    // Drop the oldest entry.
+    void dropOldest();
+
+    // Find room for an entry of MAX_ENCODED bytes at mHead, dropping the
+    // oldest entries as needed.
+    void makeRoom();
+
+    public:
+        // Create a RewindBuffer that encodes into the arenaSize bytes at
+        // arena, and keeps at most entryCount frames, in entries. The arena
+        // must be bigger than MAX_ENCODED bytes.
+        RewindBuffer(uint8_t *arena, uint32_t arenaSize, RewindEntry *entries, uint32_t entryCount);
+
+        // Forget all history.
+        void reset();
+
+        // Add state as the newest frame.
+        void push(const SaveState &state);
+
+        // Drop the newest frame, and return the state before it, or NULL if
+        // there's no earlier state left. The result is valid until the next
+        // call.
+        const SaveState* pop();
+
+        // The number of frames that can be stepped back.
+        uint32_t frames() { return mCount > 0 ? mCount - 1 : 0; }
+};
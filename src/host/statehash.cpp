@@ -0,0 +1,48 @@
+#include "statehash.hpp"
+
+#include <string.h>
+
+// FNV-1a, but mixing in 8 bytes at a time, since it's run every frame.
+static const uint64_t FNV_OFFSET = 0xCBF29CE484222325ULL;
+static const uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+static uint64_t mix(uint64_t hash, const void *data, uint16_t size) {
+    const uint8_t *bytes = (const uint8_t*)data;
+    while(size >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        hash = (hash ^ word) * FNV_PRIME;
+        bytes += 8;
+        size -= 8;
+    }
+    while(size--) hash = (hash ^ *bytes++) * FNV_PRIME;
+    return hash;
+}
+
+uint32_t hashState(const EmuState &state, const Framebuffer &framebuffer, Memory &memory) {
+    uint64_t hash = FNV_OFFSET;
+
+    // Field by field, since the struct has padding.
+    uint16_t regs[] = {
+        state.PC, state.Instruction, state.NextPC, state.Index,
+        state.DelayTimer, state.StackPointer, state.Buttons, state.WaitKeyDest,
+        (uint16_t)(state.Running | state.AwaitingKey << 1 | state.AwaitingDisplay << 2),
+    };
+    hash = mix(hash, regs, sizeof(regs));
+    hash = mix(hash, state.V, sizeof(state.V));
+    hash = mix(hash, state.R, sizeof(state.R));
+    hash = mix(hash, state.Stack, sizeof(state.Stack));
+    hash = mix(hash, &state.Random, sizeof(state.Random));
+
+    for(uint8_t y = 0; y < framebuffer.height(); y++) {
+        hash = mix(hash, framebuffer.row(y), framebuffer.width() / 8);
+    }
+
+    uint8_t chunk[128];
+    for(uint16_t addr = 0; addr < 0x1000; addr += sizeof(chunk)) {
+        memory.read(addr, chunk, sizeof(chunk));
+        hash = mix(hash, chunk, sizeof(chunk));
+    }
+
+    return hash ^ hash >> 32;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "../chip8/state.hpp"
+#include "../chip8/memory.hpp"
+#include "../chip8/framebuffer.hpp"
+
+#include <stdint.h>
+
+// A hash of everything a program can observe: the registers, timers, keys,
+// the screen, and the 4K address space. Two runs that hash the same at every
+// frame behaved the same.
+//
+// The emulator's own bookkeeping (like idle loop tracking) isn't included, so
+// it's free to change without changing the hashes of recorded runs.
+uint32_t hashState(const EmuState &state, const Framebuffer &framebuffer, Memory &memory);
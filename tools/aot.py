@@ -0,0 +1,188 @@
+"""Ahead-of-time compilation of Chip8 programs into C++.
+
+Control flow is traced from the program entry point to find the addresses that
+execution can reach, and the addresses where a block of straight-line code can
+start. Each block is then compiled into C++ operating on the emulator's
+EmuState. The generated function dispatches on state.NextPC and returns the
+number of instructions it ran (see src/chip8/aot.hpp).
+
+Anything that isn't a plain register operation (drawing, memory access, calls,
+returns, key waits, computed jumps...) ends a block, and is left to the
+interpreter. Blocks never cross a 256-byte page, so the emulator can ignore
+compiled code for pages that a program modifies.
+"""
+
+PROGRAM_START = 0x200
+
+# Longest run of instructions compiled into one block.
+MAX_BLOCK = 16
+
+
+def fetch(rom, addr):
+    """Return the instruction word at addr, or None if it's outside the rom."""
+    offset = addr - PROGRAM_START
+    if offset < 0 or offset + 1 >= len(rom):
+        return None
+    return rom[offset] << 8 | rom[offset + 1]
+
+
+def successors(addr, inst):
+    """Return the addresses that execution can continue at after inst."""
+    op = inst >> 12
+    if inst in (0x00EE, 0x00FD):
+        return []
+    if op == 0x1:
+        # The hi-res setup hack in Chip8::groupJump.
+        if addr == 0x200 and inst == 0x1260:
+            return [0x2C0]
+        return [inst & 0xFFF]
+    if op == 0x2:
+        return [inst & 0xFFF, addr + 2]
+    if op == 0xB:
+        # Computed jump, we can't follow it.
+        return []
+    if op in (0x3, 0x4, 0x5, 0x9, 0xE):
+        return [addr + 2, addr + 4]
+    return [addr + 2]
+
+
+class Compiler():
+    """Compiles a single rom into a C++ function."""
+
+    def __init__(self, rom, shiftquirk, vfresetquirk):
+        self.rom = rom
+        self.shiftquirk = shiftquirk
+        self.vfresetquirk = vfresetquirk
+
+    def alu(self, inst):
+        """C++ for the 0x8XYx ALU group, or None."""
+        x = (inst >> 8) & 0xF
+        y = (inst >> 4) & 0xF
+        vx = "s.V[0x{:X}]".format(x)
+        vy = "s.V[0x{:X}]".format(y)
+        src = vx if self.shiftquirk else vy
+        reset = " s.V[0xF] = 0;" if self.vfresetquirk else ""
+        return {
+            0x0: "{0} = {1};".format(vx, vy),
+            0x1: "{0} |= {1};{2}".format(vx, vy, reset),
+            0x2: "{0} &= {1};{2}".format(vx, vy, reset),
+            0x3: "{0} ^= {1};{2}".format(vx, vy, reset),
+            0x4: "{{ uint16_t t = {0} + {1}; {0} = t; s.V[0xF] = t > 0xFF; }}".format(vx, vy),
+            0x5: "{{ uint8_t f = {0} >= {1}; {0} -= {1}; s.V[0xF] = f; }}".format(vx, vy),
+            0x6: "{{ uint8_t v = {1}; {0} = v >> 1; s.V[0xF] = v & 1; }}".format(vx, src),
+            0x7: "{{ uint8_t f = {1} >= {0}; {0} = {1} - {0}; s.V[0xF] = f; }}".format(vx, vy),
+            0xE: "{{ uint8_t v = {1}; {0} = v << 1; s.V[0xF] = v >> 7; }}".format(vx, src),
+        }.get(inst & 0xF)
+
+    def load(self, inst):
+        """C++ for the register-only parts of the 0xFXxx group, or None."""
+        vx = "s.V[0x{:X}]".format((inst >> 8) & 0xF)
+        return {
+            0x07: "{0} = s.DelayTimer;".format(vx),
+            0x15: "s.DelayTimer = {0};".format(vx),
+            0x1E: "s.Index += {0};".format(vx),
+            0x29: "s.Index = 5 * {0};".format(vx),
+            0x30: "s.Index = 0x10*5 + 10 * {0};".format(vx),
+        }.get(inst & 0xFF)
+
+    def translate(self, addr, inst):
+        """Return (C++ statement, ends block) for inst, or (None, True) if the
+        interpreter has to run it."""
+        op = inst >> 12
+        x = (inst >> 8) & 0xF
+        vx = "s.V[0x{:X}]".format(x)
+        vy = "s.V[0x{:X}]".format((inst >> 4) & 0xF)
+        nn = inst & 0xFF
+        skip = "s.NextPC = ({}) ? 0x{:04X} : 0x{:04X};"
+        if op == 0x1 and not (addr == 0x200 and inst == 0x1260):
+            return "s.NextPC = 0x{:04X};".format(inst & 0xFFF), True
+        if op == 0x3:
+            return skip.format("{} == 0x{:02X}".format(vx, nn), addr + 4, addr + 2), True
+        if op == 0x4:
+            return skip.format("{} != 0x{:02X}".format(vx, nn), addr + 4, addr + 2), True
+        if op == 0x5:
+            return skip.format("{} == {}".format(vx, vy), addr + 4, addr + 2), True
+        if op == 0x9:
+            return skip.format("{} != {}".format(vx, vy), addr + 4, addr + 2), True
+        if op == 0x6:
+            return "{} = 0x{:02X};".format(vx, nn), False
+        if op == 0x7:
+            return "{} += 0x{:02X};".format(vx, nn), False
+        if op == 0x8:
+            return self.alu(inst), False
+        if op == 0xA:
+            return "s.Index = 0x{:03X};".format(inst & 0xFFF), False
+        if op == 0xC:
+            return "{} = nextRandom(s) & 0x{:02X};".format(vx, nn), False
+        if op == 0xF:
+            return self.load(inst), False
+        return None, True
+
+    def leaders(self):
+        """Find every reachable address where a block should start."""
+        leaders = {PROGRAM_START}
+        seen = set()
+        work = [PROGRAM_START]
+        while work:
+            addr = work.pop()
+            if addr in seen:
+                continue
+            seen.add(addr)
+            inst = fetch(self.rom, addr)
+            if inst is None:
+                continue
+            nexts = successors(addr, inst)
+            stmt, ends = self.translate(addr, inst)
+            # Any control transfer, or an instruction that the interpreter
+            # runs, means execution can pick up at a successor.
+            if ends or stmt is None:
+                leaders.update(nexts)
+            work.extend(nexts)
+        return sorted(a for a in leaders if fetch(self.rom, a) is not None)
+
+    def block(self, start):
+        """Compile the block starting at start. Returns a list of lines."""
+        lines = []
+        addr = start
+        last = None
+        ended = False
+        count = 0
+        while count < MAX_BLOCK and not ended:
+            # Stay within the page, including the second instruction byte.
+            if (addr + 1) >> 8 != start >> 8:
+                break
+            inst = fetch(self.rom, addr)
+            if inst is None:
+                break
+            stmt, ends = self.translate(addr, inst)
+            if stmt is None:
+                break
+            ended = ends
+            lines.append("{:60s}// 0x{:04X}: {:04X}".format(stmt, addr, inst))
+            last = (addr, inst)
+            count += 1
+            addr += 2
+
+        if count == 0:
+            return []
+        if not ended:
+            lines.append("s.NextPC = 0x{:04X};".format(addr))
+        lines.append("s.PC = 0x{:04X};".format(last[0]))
+        lines.append("s.Instruction = 0x{:04X};".format(last[1]))
+        lines.append("return {};".format(count))
+        return lines
+
+    def emit(self, name):
+        """Print the C++ function for the rom."""
+        print("uint8_t {}(EmuState &s) {{".format(name))
+        print("    switch(s.NextPC) {")
+        for leader in self.leaders():
+            lines = self.block(leader)
+            if not lines:
+                continue
+            print("        case 0x{:04X}:".format(leader))
+            for line in lines:
+                print("            " + line)
+        print("    }")
+        print("    return 0;")
+        print("}\n")
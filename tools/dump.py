@@ -5,12 +5,18 @@ import sys
 from typing import NamedTuple
 from dataclasses import dataclass
 from op import Op
+from aot import Compiler
 
 @dataclass
 class ProgramInfo():
     keymap: str = ""
     info: str = ""
     shiftquirk: bool = False
+    vfresetquirk: bool = False
+    loadstorequirk: bool = False
+    jumpquirk: bool = False
+    clipquirk: bool = False
+    displaywaitquirk: bool = False
 
 class Program(NamedTuple):
     name: str
@@ -18,6 +24,7 @@ class Program(NamedTuple):
     size: int
     super: bool
     info: ProgramInfo
+    aot: str
 
 def read_group(f, pc):
     next_group = f.read(16)
@@ -48,6 +55,18 @@ def dump_program_to_array(base, filename, codename):
 # Octo WASD configuration
 DEFAULT_KEYMAP = "0x58, 0x79, 0x46"
 
+# Quirk flags, each of which can appear on its own line in a .info file.
+QUIRKS = ["shiftquirk", "vfresetquirk", "loadstorequirk", "jumpquirk",
+          "clipquirk", "displaywaitquirk"]
+
+# Named sets of quirks, for `quirks=<name>` in a .info file. These match the
+# profiles in src/chip8/config.hpp, which get specialized dispatch.
+QUIRK_PROFILES = {
+    "vip": ["vfresetquirk", "loadstorequirk", "clipquirk", "displaywaitquirk"],
+    "schip": ["shiftquirk", "jumpquirk", "clipquirk"],
+    "xochip": ["loadstorequirk"],
+}
+
 def get_program_info(base, filename):
     pgm = ProgramInfo(keymap=DEFAULT_KEYMAP)
 
@@ -55,8 +74,11 @@ def get_program_info(base, filename):
         f = open(os.path.join(base, "{}.info".format(filename)))
         for line in (l.strip() for l in f.readlines()):
             field, *rest = line.split("=", 2)
-            if field == "shiftquirk":
-                pgm.shiftquirk = True
+            if field in QUIRKS:
+                setattr(pgm, field, True)
+            elif field == "quirks":
+                for quirk in QUIRK_PROFILES[rest[0]]:
+                    setattr(pgm, quirk, True)
             elif field == "info":
                 pgm.info = rest[0]
             elif field == "keymap":
@@ -68,18 +90,26 @@ def get_program_info(base, filename):
     return pgm
 
 
-def get_program(base, fullname):
+def dump_program_aot(base, filename, codename, info):
+    name = "aot_{}".format(codename)
+    with open(os.path.join(base, filename), 'rb') as progfile:
+        Compiler(progfile.read(), info.shiftquirk, info.vfresetquirk).emit(name)
+    return name
+
+
+def get_program(base, fullname, aot):
     filename, ext = os.path.splitext(fullname)
     codename = re.sub('[^a-zA-Z0-9_]', '_', filename)+"_"+ext[1:]
     info = get_program_info(base, filename)
     size = dump_program_to_array(base, fullname, codename)
-    return Program(filename, codename, size, ext == ".sch8", info)
+    aotname = dump_program_aot(base, fullname, codename, info) if aot else "NULL"
+    return Program(filename, codename, size, ext == ".sch8", info, aotname)
 
 
-def dump_all_roms(base):
+def dump_all_roms(base, aot=False):
     menu = open(os.path.join(base, "menu"))
 
-    programs = [get_program(base, name.strip()) for name in menu.readlines()]
+    programs = [get_program(base, name.strip(), aot) for name in menu.readlines()]
 
     print("const uint8_t PROGRAM_COUNT = {};".format(len(programs)))
     for p in programs:
@@ -98,10 +128,19 @@ def dump_all_roms(base):
         .super={0.super:d},
         .info=(uint8_t*)info_{0.codename},
         .keymap={{{0.info.keymap}}},
-        .shiftquirk={0.info.shiftquirk:d},
+        .config={{
+            .ShiftQuirk={0.info.shiftquirk:d},
+            .VfResetQuirk={0.info.vfresetquirk:d},
+            .LoadStoreQuirk={0.info.loadstorequirk:d},
+            .JumpQuirk={0.info.jumpquirk:d},
+            .ClipQuirk={0.info.clipquirk:d},
+            .DisplayWaitQuirk={0.info.displaywaitquirk:d},
+        }},
+        .aot={0.aot},
     }},""".format(p))
     print("};")
 
 if __name__ == "__main__":
+    # --aot also compiles each program ahead of time (see aot.py).
     print("#include \"program.h\"")
-    dump_all_roms("roms")
+    dump_all_roms("roms", aot="--aot" in sys.argv[1:])